@@ -0,0 +1,30 @@
+#include "Breakpoints.h"
+
+void Breakpoints::add(Kind kind, uint16_t address) {
+  address = canonical(address);
+  addresses[index(kind)][address] = true;
+  pages[address >> 8] |= kind;
+}
+
+void Breakpoints::remove(Kind kind, uint16_t address) {
+  address = canonical(address);
+  auto &points = addresses[index(kind)];
+  points[address] = false;
+
+  // Clear the page flag once its last point is gone
+  uint16_t first = address & 0xFF00;
+  for (uint16_t offset = 0; offset < 0x100; offset++) {
+    if (points[first + offset]) {
+      return;
+    }
+  }
+  pages[address >> 8] &= ~kind;
+}
+
+void Breakpoints::clear() {
+  pages.fill(0);
+  for (auto &points : addresses) {
+    points.reset();
+  }
+  has_hit = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+/**
+ Breakpoints on PC and watchpoints on memory reads and writes.
+
+ Each 256 bytes page of the address space carries one flag per kind,
+ set while the page holds at least one point of that kind. The bus and
+ the debug run loop only test that flag on their fast path; the exact
+ address is looked up only on flagged pages.
+
+ Points on internal RAM cover all of its mirrors: an address below $2000
+ is stored and looked up as its offset in the 2 KiB RAM, so a watch on
+ $0300 also catches $0B00. Hits report the address actually accessed.
+
+ A watchpoint hit does not interrupt the access: it is latched and the
+ debug run loop stops once the current instruction completes.
+ */
+class Breakpoints {
+public:
+  enum Kind : uint8_t { EXECUTE = 1 << 0, READ = 1 << 1, WRITE = 1 << 2 };
+
+  struct Hit {
+    Kind kind;
+    uint16_t address;
+    uint8_t value; // Value written, for WRITE hits
+  };
+
+  void add(Kind kind, uint16_t address);
+  void remove(Kind kind, uint16_t address);
+  void clear();
+
+  bool onPage(Kind kind, uint16_t address) const {
+    return pages[canonical(address) >> 8] & kind;
+  }
+  bool contains(Kind kind, uint16_t address) const {
+    return addresses[index(kind)][canonical(address)];
+  }
+
+  // Slow path of flagged pages: latch a hit if address is watched
+  void check(Kind kind, uint16_t address, uint8_t value = 0) {
+    if (contains(kind, address) && !has_hit) {
+      last_hit = Hit{kind, address, value};
+      has_hit = true;
+    }
+  }
+
+  bool triggered() const { return has_hit; }
+  Hit takeHit() {
+    has_hit = false;
+    return last_hit;
+  }
+
+private:
+  static constexpr int index(Kind kind) { return kind == EXECUTE ? 0 : kind == READ ? 1 : 2; }
+  // Internal RAM mirrors fold onto $0000-$07FF
+  static constexpr uint16_t canonical(uint16_t address) {
+    return address <= 0x1FFF ? address & 0x7FF : address;
+  }
+
+  std::array<uint8_t, 0x100> pages{};
+  std::array<std::bitset<0x10000>, 3> addresses{};
+  Hit last_hit{};
+  bool has_hit = false;
+};
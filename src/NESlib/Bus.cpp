@@ -1,27 +1,57 @@
 #include "Bus.h"
+#include "Log.h"
 #include <iomanip>
 #include <iostream>
 
-Bus::Bus(Mapper *mapper) : mapper(mapper) { ram.resize(0xFFFF + 1, 0); }
+Bus::Bus(Mapper *mapper) : mapper(mapper), ppu(mapper, &interrupt_lines) {
+  ram.resize(0xFFFF + 1, 0);
+  ram_hash = zobristHash(Zobrist::RAM, ram.data(), 0x800);
+}
 
 void Bus::writeByte(uint16_t address, uint8_t value) {
-  if (address <= 0x401F) {
+  if (break_points.onPage(Breakpoints::WRITE, address)) [[unlikely]] {
+    break_points.check(Breakpoints::WRITE, address, value);
+  }
+
+  if (address <= 0x1FFF) {
     // Internal RAM & mirrors
-    ram.at(address % 0x800) = value;
+    uint16_t offset = address % 0x800;
+    ram_hash ^= zobrist(Zobrist::RAM + offset, ram[offset]) ^ zobrist(Zobrist::RAM + offset, value);
+    ram[offset] = value;
+    ram_dirty.mark(offset);
+  } else if (address <= 0x3FFF) {
+    ppu.writeRegister(address, value);
+  } else if (address == 0x4014) {
+    oamDMA(value);
+  } else if (address == 0x4016) {
+    controllers[0].strobe(value);
+    controllers[1].strobe(value);
+  } else if (address <= 0x401F) {
+    // APU & IO registers are not emulated yet
+    NES_LOG_TRACE(LogCategory::APU, "APU/IO register $%04X written with $%02X", address, value);
   } else {
     mapper->writePRG(address, value);
+#ifdef NES_PROFILER
+    prg_generation++;
+#endif
   }
 }
 
 uint8_t Bus::readByte(uint16_t address) {
+  if (break_points.onPage(Breakpoints::READ, address)) [[unlikely]] {
+    break_points.check(Breakpoints::READ, address);
+  }
+
   if (address <= 0x1FFF) {
     // Internal RAM & mirrors
     return ram[address % 0x800];
   } else if (address <= 0x3FFF) {
-    std::cout << "PPU Register accessed" << std::endl;
-    return 0x0;
+    return ppu.readRegister(address);
+  } else if (address == 0x4016 || address == 0x4017) {
+    // Only D0 is driven, the upper bits keep the last byte on the bus
+    return controllers[address & 1].read() | 0x40;
   } else if (address <= 0x401F) {
-    std::cout << "APU || IO register accessed" << std::endl;
+    NES_LOG_TRACE(LogCategory::APU, "APU/IO register $%04X read", address);
     return 0x0;
   } else {
     // Cartridge space, defer to the mapper
@@ -29,6 +59,74 @@ uint8_t Bus::readByte(uint16_t address) {
   }
 }
 
+uint8_t Bus::peekByte(uint16_t address) const {
+  if (address <= 0x1FFF) {
+    return ram[address % 0x800];
+  } else if (address <= 0x401F) {
+    return 0x0;
+  }
+  return mapper->readPRG(address);
+}
+
+void Bus::oamDMA(uint8_t page) {
+  uint16_t source = page << 8;
+  if (source <= 0x1FFF) {
+    // Internal RAM pages never straddle a mirror boundary, the copy skips
+    // readByte so read watchpoints are checked here
+    if (break_points.onPage(Breakpoints::READ, source)) [[unlikely]] {
+      for (std::size_t i = 0; i < PPU::OAM_SIZE; i++) {
+        break_points.check(Breakpoints::READ, source + i);
+      }
+    }
+    ppu.writeOAM(&ram[source % 0x800]);
+  } else {
+    uint8_t buffer[PPU::OAM_SIZE];
+    for (std::size_t i = 0; i < PPU::OAM_SIZE; i++) {
+      buffer[i] = readByte(source + i);
+    }
+    ppu.writeOAM(buffer);
+  }
+
+  // 256 reads and 256 writes plus a halt cycle, the CPU adds one more
+  // alignment cycle when the transfer starts on an odd cycle
+  dma_stall += 513;
+  interrupt_lines.requestHalt();
+}
+
+uint16_t Bus::takeDMAStall() {
+  uint16_t stall = dma_stall;
+  dma_stall = 0;
+  interrupt_lines.releaseHalt();
+  return stall;
+}
+
+void Bus::serialize(Serializer &s) {
+  s.blocks(ram.data(), ram_dirty);
+  interrupt_lines.serialize(s);
+  controllers[0].serialize(s);
+  controllers[1].serialize(s);
+  s.value(dma_stall);
+  s.value(ram_hash);
+  ppu.serialize(s);
+  mapper->serialize(s);
+#ifdef NES_PROFILER
+  if (s.loading()) {
+    prg_generation++;
+  }
+#endif
+}
+
+uint64_t Bus::fingerprint() {
+  uint64_t words[] = {
+      ram_hash,
+      ppu.fingerprint(),
+      mapper->fingerprint(),
+      controllers[0].fingerprint() | (uint64_t{controllers[1].fingerprint()} << 32),
+      interrupt_lines.state() | (uint64_t{dma_stall} << 8),
+  };
+  return hash64(words, sizeof(words));
+}
+
 template <typename T> std::string Bus::print_hex(T a, int size) {
   std::stringstream ss;
   ss << std::setw(size) << std::setfill('0') << std::hex << (int)a;
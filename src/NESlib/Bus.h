@@ -1,8 +1,15 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <string>
+#include "Breakpoints.h"
+#include "Controller.h"
+#include "DirtyBitmap.h"
+#include "Interrupts.h"
+#include "PPU.h"
+#include "StateHash.h"
 #include "mappers/Mapper.h"
 
 /**
@@ -19,6 +26,8 @@ NES Memory bus, using 2-bytes adresses.
     $2000 - $2007       PPU registers
     $2008 - $3FFF       mirrors $2000 - $2007
  $4000 - $4017      APU & IO
+    $4014               OAM DMA, copies a CPU page to PPU OAM
+    $4016 - $4017       controllers
  $4020 - $FFFF      Cartridge space, see mappers for details
     $FFFA - $FFFB       NMI Vector
     $FFFC - $FFFD       Reset Vector
@@ -35,10 +44,66 @@ public:
 
   uint8_t readByte(uint16_t address);
   void writeByte(uint16_t address, uint8_t value);
+  // Side-effect free read for tools: no watchpoints, I/O registers read 0
+  uint8_t peekByte(uint16_t address) const;
+
+  uint16_t prgBank(uint16_t address) {
+    return address >= 0x4020 ? mapper->prgBank(address) : 0;
+  }
+#ifdef NES_PROFILER
+  // prgBank() remembered per 256-byte page, for the per-instruction
+  // profiler hook. Banks only switch on cartridge writes and state loads,
+  // which forget every page.
+  uint16_t cachedPrgBank(uint16_t address) {
+    if (address < 0x4020) {
+      return 0;
+    }
+    PageBank &page = prg_banks[address >> 8];
+    if (page.generation != prg_generation) [[unlikely]] {
+      page = PageBank{prg_generation, mapper->prgBank(address)};
+    }
+    return page.bank;
+  }
+#endif
+
+  InterruptLines& interrupts() { return interrupt_lines; }
+  Breakpoints& breakpoints() { return break_points; }
+  PPU& getPPU() { return ppu; }
+  // Internal RAM, $0000 - $07FF
+  const uint8_t* getRAM() const { return ram.data(); }
+  // Internal RAM blocks written since the last serialization
+  using RAMDirtyBitmap = DirtyBitmap<0x800, 64>;
+  RAMDirtyBitmap& dirtyRAM() { return ram_dirty; }
+  Controller& controller(int port) { return controllers[port & 1]; }
+
+  // CPU cycles the last DMA halts the CPU for, read once by the CPU
+  uint16_t takeDMAStall();
+
+  // Internal RAM comes first, then I/O, PPU and mapper state
+  void serialize(Serializer &s);
+  // Hash of RAM, I/O, PPU and mapper state in O(1), see NES::fingerprint
+  uint64_t fingerprint();
 
   template<typename T>static std::string print_hex(T a, int size);
   void printState(uint16_t start, uint16_t end);
 private:
+  void oamDMA(uint8_t page);
+
   std::vector<uint8_t> ram;
+  RAMDirtyBitmap ram_dirty;
+  uint64_t ram_hash{}; // Zobrist hash of the internal RAM
   Mapper *mapper;
+  PPU ppu;
+  InterruptLines interrupt_lines;
+  Controller controllers[2];
+  Breakpoints break_points;
+  uint16_t dma_stall{};
+#ifdef NES_PROFILER
+  struct PageBank {
+    uint64_t generation;
+    uint16_t bank;
+  };
+  std::array<PageBank, 256> prg_banks{};
+  uint64_t prg_generation = 1;
+#endif
 };
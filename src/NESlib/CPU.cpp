@@ -10,6 +10,7 @@
 
 #include "Bus.h"
 #include "CPU.h"
+#include "StateHash.h"
 
 enum opcode_c0_b0_implied { BRK, JSR, RTI, RTS };
 enum opcode_c0_b2_implied { PHP, PLP, PHA, PLA, DEY, TAY, INY, INX };
@@ -40,6 +41,28 @@ enum adressingModes_c2 {
 enum opcode_c1 { ORA, AND, EOR, ADC, STA, LDA, CMP, SBC };
 enum flags { N_f, V_f, B_f, D_f, I_f, Z_f, C_f };
 
+// Base cycle count of each opcode. Taken branches add their penalty in
+// step(); page crossings of indexed reads are not modelled yet.
+static constexpr uint8_t cycle_table[256] = {
+    7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6, // 0x00
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0x10
+    6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6, // 0x20
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0x30
+    6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6, // 0x40
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0x50
+    6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6, // 0x60
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0x70
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // 0x80
+    2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5, // 0x90
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // 0xA0
+    2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, // 0xB0
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // 0xC0
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0xD0
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // 0xE0
+    2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 0xF0
+};
+static constexpr uint8_t interrupt_cycles = 7;
+
 /******* Public functions *******/
 CPU_6502::CPU_6502(Bus *ram) : ram(ram) { CPU_6502::reset(); }
 
@@ -50,14 +73,60 @@ void CPU_6502::reset() {
 
   reg.PC = reset_vector;
   reg.flags = std::bitset<8>{0b00110100};
+  cycles += interrupt_cycles;
+  jam = false;
+}
+
+void CPU_6502::serialize(Serializer &s) {
+  s.value(reg.A);
+  s.value(reg.X);
+  s.value(reg.Y);
+  s.value(reg.PC);
+  s.value(reg.SP);
+  uint8_t flags = reg.flags.to_ulong();
+  s.value(flags);
+  s.value(nmi_vector);
+  s.value(reset_vector);
+  s.value(irq_vector);
+  s.value(cycles);
+  s.value(jam);
+  if (s.loading()) {
+    reg.flags = std::bitset<8>{flags};
+    idle.target = -1;
+    breakpoint_resume_pc = -1;
+  }
+}
+
+uint64_t CPU_6502::fingerprint() const {
+  uint8_t registers[] = {
+      reg.A, reg.X, reg.Y, static_cast<uint8_t>(reg.PC), static_cast<uint8_t>(reg.PC >> 8),
+      reg.SP, static_cast<uint8_t>(reg.flags.to_ulong()), jam,
+  };
+  return hash64(registers, sizeof(registers));
 }
 
 void CPU_6502::step() {
   // CPU_6502::print_state();
 
+  // Single test on the folded interrupt lines; servicing an interrupt
+  // takes the place of the next instruction
+  if (ram->interrupts().state() != 0) [[unlikely]] {
+    if (serviceInterrupts()) {
+      return;
+    }
+  }
+
+#ifdef NES_PROFILER
+  // Bank the instruction is fetched from, before it switches banks
+  const uint16_t profiled_bank = profiler ? ram->cachedPrgBank(reg.PC) : 0;
+  const uint16_t profiled_pc = reg.PC;
+  const uint64_t profiled_cycles = cycles;
+#endif
+
   // Read the opcode at the current program counter address and increment it
   uint8_t opcode = ram->readByte(reg.PC);
   reg.PC++;
+  cycles += cycle_table[opcode];
 
   /* Decompose the opcode as the binary vector 'aaabbbcc'
   In a general sense, a depends on the instruction, mode on the addressing mode,
@@ -75,6 +144,7 @@ void CPU_6502::step() {
   switch (category) {
   case 0b00: {
     if (mode == 0 && instruction <= 3) {
+      uint16_t from = reg.PC - 1;
       switch (instruction) {
       case BRK:
         reg.PC += 1;
@@ -84,22 +154,27 @@ void CPU_6502::step() {
         ram->writeByte(reg.SP--, (uint8_t)(reg.flags.to_ulong()));
         reg.flags[I_f] = true;
         reg.PC = irq_vector;
+        profileCall(reg.SP + 3);
         break;
       case JSR:
         ram->writeByte(reg.SP--, ((reg.PC + 2) >> 8) & 0xFF);
         ram->writeByte(reg.SP--, ((reg.PC + 2) & 0xFF));
         reg.PC = readAddressAndIncrementPC(ABS);
+        profileCall(reg.SP + 2);
         break;
       case RTI:
         reg.flags = ram->readByte(++reg.SP);
         reg.flags[B_f] = false;
         reg.flags[I_f] = false;
         reg.PC = ram->readByte(++reg.SP) + (ram->readByte(++reg.SP) << 8);
+        profileReturn();
         break;
       case RTS:
         reg.PC = ram->readByte(++reg.SP) + (ram->readByte(++reg.SP) << 8);
+        profileReturn();
         break;
       }
+      coverEdge(from);
     } else if (mode == 2) {
       switch (instruction) {
       case PHP:
@@ -168,11 +243,20 @@ void CPU_6502::step() {
         break;
       }
 
+      uint16_t branch_pc = reg.PC - 1;
       if (doJump) {
+        uint16_t next = reg.PC + 1;
         reg.PC += (int8_t)(ram->readByte(reg.PC));
+        // One more cycle when taken, two when crossing a page
+        cycles += ((next ^ (reg.PC + 1)) & 0xFF00) ? 2 : 1;
       }
 
       reg.PC += 1;
+      coverEdge(branch_pc);
+
+      if (doJump && reg.PC <= branch_pc) {
+        onBackwardJump(branch_pc);
+      }
 
     } else if (mode == 6) {
       switch (instruction) {
@@ -224,14 +308,22 @@ void CPU_6502::step() {
         reg.flags[V_f] = value & 0x40;
         break;
       }
-      case JMP_abs:
+      case JMP_abs: {
+        uint16_t jump_pc = reg.PC - 1;
         reg.PC = readAddressAndIncrementPC(ABS);
+        coverEdge(jump_pc);
+        if (reg.PC <= jump_pc) {
+          onBackwardJump(jump_pc);
+        }
         break;
+      }
       case JMP_ind: {
+        uint16_t jump_pc = reg.PC - 1;
         uint16_t indirectAddress =
             ram->readByte(reg.PC) + (ram->readByte(reg.PC + 1) << 8);
         reg.PC = ram->readByte(indirectAddress) +
                  (ram->readByte(indirectAddress + 1) << 8);
+        coverEdge(jump_pc);
         break;
       }
       case STY:
@@ -330,6 +422,12 @@ void CPU_6502::step() {
     break;
   }
   case 0b10: {
+    if (mode == 4 || (mode == 0 && instruction < 4)) [[unlikely]] {
+      // JAM, the CPU keeps fetching the same opcode
+      reg.PC--;
+      jam = true;
+      break;
+    }
     switch (instruction) {
     case ASL: {
       uint16_t value{};
@@ -507,6 +605,13 @@ void CPU_6502::step() {
     break;
   }
   }
+
+#ifdef NES_PROFILER
+  if (profiler) {
+    profiler->record(profiled_bank, profiled_pc, opcode,
+                     cycles - profiled_cycles);
+  }
+#endif
 }
 
 void CPU_6502::step(int nbSteps) {
@@ -514,8 +619,145 @@ void CPU_6502::step(int nbSteps) {
     this->step();
 }
 
+void CPU_6502::run(uint64_t cycleLimit) {
+  idle.target = -1;
+  idle_skip_limit = idle_skipping ? cycleLimit : 0;
+  while (cycles < cycleLimit) {
+    this->step();
+  }
+  idle_skip_limit = 0;
+}
+
+/******* Idle loops *******/
+
+namespace {
+
+enum IdleOperand { NO_OPERAND, ZERO_PAGE_OPERAND, ABSOLUTE_OPERAND };
+struct IdleOpcode {
+  uint8_t length; // 0 when the opcode may have side effects
+  IdleOperand operand;
+};
+
+// Opcodes which only read memory or touch registers and flags, so that
+// repeating them from the same state yields the same state
+IdleOpcode idleOpcode(uint8_t opcode) {
+  switch (opcode) {
+  // LDA, LDX, LDY, CMP, CPX, CPY, AND, ORA, EOR immediate
+  case 0xA9: case 0xA2: case 0xA0: case 0xC9: case 0xE0: case 0xC0:
+  case 0x29: case 0x09: case 0x49:
+    return {2, NO_OPERAND};
+  // Same and BIT, zero page
+  case 0xA5: case 0xA6: case 0xA4: case 0xC5: case 0xE4: case 0xC4:
+  case 0x25: case 0x05: case 0x45: case 0x24:
+    return {2, ZERO_PAGE_OPERAND};
+  // Same and BIT, absolute
+  case 0xAD: case 0xAE: case 0xAC: case 0xCD: case 0xEC: case 0xCC:
+  case 0x2D: case 0x0D: case 0x4D: case 0x2C:
+    return {3, ABSOLUTE_OPERAND};
+  // Branches
+  case 0x10: case 0x30: case 0x50: case 0x70:
+  case 0x90: case 0xB0: case 0xD0: case 0xF0:
+    return {2, NO_OPERAND};
+  // Register transfers, flags and NOP
+  case 0xAA: case 0xA8: case 0x8A: case 0x98:
+  case 0x18: case 0x38: case 0xB8: case 0xD8: case 0xF8: case 0xEA:
+    return {1, NO_OPERAND};
+  default:
+    return {0, NO_OPERAND};
+  }
+}
+
+} // namespace
+
+bool CPU_6502::isIdleLoopBody(uint16_t start, uint16_t end) const {
+  if (end - start > 32) {
+    return false;
+  }
+  uint16_t pc = start;
+  while (pc < end) {
+    IdleOpcode decoded = idleOpcode(ram->peekByte(pc));
+    if (decoded.length == 0) {
+      return false;
+    }
+    if (decoded.operand == ABSOLUTE_OPERAND) {
+      // RAM and ROM are stable between two events, of the I/O registers
+      // only PPUSTATUS reads are idempotent
+      uint16_t address = ram->peekByte(pc + 1) | (ram->peekByte(pc + 2) << 8);
+      if (address >= 0x2000 && address <= 0x401F && (address & 0xE007) != 0x2002) {
+        return false;
+      }
+    }
+    pc += decoded.length;
+  }
+  // The closing instruction itself is a branch or JMP abs
+  return pc == end;
+}
+
+void CPU_6502::onBackwardJump(uint16_t from) {
+  if (idle_skip_limit == 0) {
+    return;
+  }
+
+  if (idle.target == reg.PC && idle.from == from) {
+    if (idle.registers.A == reg.A && idle.registers.X == reg.X &&
+        idle.registers.Y == reg.Y && idle.registers.SP == reg.SP &&
+        idle.registers.flags == reg.flags) {
+      // Same state at the same point and no write in between: every
+      // iteration until the next event is identical, skip whole ones
+      uint64_t period = cycles - idle.cycles;
+      if (period != 0 && cycles < idle_skip_limit) {
+        uint64_t iterations = (idle_skip_limit - cycles) / period;
+        cycles += iterations * period;
+        idle_skipped_cycles += iterations * period;
+      }
+    }
+  } else if (!isIdleLoopBody(reg.PC, from)) {
+    idle.target = -1;
+    return;
+  }
+
+  idle.target = reg.PC;
+  idle.from = from;
+  idle.registers = reg;
+  idle.cycles = cycles;
+}
+
 /******* Debug functions *******/
 
+CPU_6502::Stop CPU_6502::runUntil(uint64_t cycleLimit,
+                                  const Predicate &predicate) {
+  Breakpoints &points = ram->breakpoints();
+  if (points.triggered()) {
+    points.takeHit(); // Latched outside of a debug run
+  }
+
+  while (cycles < cycleLimit) {
+    // Resuming from a breakpoint executes the instruction it stopped on
+    if (points.onPage(Breakpoints::EXECUTE, reg.PC) && reg.PC != breakpoint_resume_pc &&
+        points.contains(Breakpoints::EXECUTE, reg.PC)) {
+      breakpoint_resume_pc = reg.PC;
+      return Stop{StopReason::Breakpoint, reg.PC, 0};
+    }
+    breakpoint_resume_pc = -1;
+
+    step();
+
+    if (points.triggered()) {
+      Breakpoints::Hit hit = points.takeHit();
+      return Stop{hit.kind == Breakpoints::READ ? StopReason::ReadWatchpoint
+                                                : StopReason::WriteWatchpoint,
+                  hit.address, hit.value};
+    }
+    if (jam) [[unlikely]] {
+      return Stop{StopReason::Jam, reg.PC, 0};
+    }
+    if (predicate && predicate(*this)) {
+      return Stop{StopReason::Predicate, reg.PC, 0};
+    }
+  }
+  return Stop{StopReason::Limit, reg.PC, 0};
+}
+
 void CPU_6502::printState() const {
   std::cout << "A=$" << print_hex(reg.A) << " X=$" << print_hex(reg.X) << " Y=$"
             << print_hex(reg.Y) << " PC=$" << print_hex(reg.PC) << " SP=$"
@@ -593,6 +835,43 @@ uint8_t CPU_6502::readByte(uint8_t mode) {
   return value;
 }
 
+bool CPU_6502::serviceInterrupts() {
+  InterruptLines &lines = ram->interrupts();
+  if (jam) {
+    return false;
+  }
+  if (lines.halt()) {
+    // DMA halted the CPU after the last write, plus one cycle to align
+    // on a get cycle when halted on an odd cycle
+    cycles += ram->takeDMAStall() + (cycles & 1);
+  }
+
+  uint16_t vector{};
+  if (lines.nmi()) {
+    lines.acknowledgeNMI();
+    vector = nmi_vector;
+  } else if (lines.irq() && !reg.flags[I_f]) {
+    // IRQ is level triggered, the source keeps it asserted until acknowledged
+    vector = irq_vector;
+  } else {
+    return false;
+  }
+
+  // Same sequence as BRK, with the break flag cleared in the pushed status
+  uint16_t from = reg.PC;
+  ram->writeByte(reg.SP--, (reg.PC >> 8) & 0xFF);
+  ram->writeByte(reg.SP--, (reg.PC & 0xFF));
+  reg.flags[B_f] = false;
+  ram->writeByte(reg.SP--, (uint8_t)(reg.flags.to_ulong()));
+  reg.flags[I_f] = true;
+  reg.PC = vector;
+  cycles += interrupt_cycles;
+  idle.target = -1;
+  profileCall(reg.SP + 3);
+  coverEdge(from);
+  return true;
+}
+
 void CPU_6502::writeByte(uint8_t mode, uint8_t value) {
   if (mode == IMM) { // Can't write to an immediate value because it is
                      // not an address
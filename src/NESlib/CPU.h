@@ -1,10 +1,27 @@
 #pragma once
 
 #include "Bus.h"
+#ifdef NES_PROFILER
+#include "CallGraph.h"
+#include "Profiler.h"
+#endif
+#ifdef NES_COVERAGE
+#include "Coverage.h"
+#endif
 #include <bitset>
 #include <cstdint>
+#include <functional>
 
 class CPU_6502 {
+public:
+  enum class StopReason { Breakpoint, ReadWatchpoint, WriteWatchpoint, Predicate, Jam, Limit };
+  struct Stop {
+    StopReason reason;
+    uint16_t address; // PC for breakpoints, predicates and jams, accessed address for watchpoints
+    uint8_t value;    // Value written, for write watchpoints
+  };
+  using Predicate = std::function<bool(const CPU_6502 &)>;
+
 private:
   Bus *ram;
   struct Registers {
@@ -22,21 +39,102 @@ private:
   uint16_t reset_vector{};
   uint16_t irq_vector{};
 
+  uint64_t cycles{}; // CPU cycles elapsed since power-up
+  bool jam{};        // Locked up by a JAM opcode until reset
+  int32_t breakpoint_resume_pc = -1; // PC of the last breakpoint stop
+
+  // Idle loop fast-forward, see onBackwardJump
+  struct IdleLoop {
+    int32_t target = -1;
+    uint16_t from{};
+    Registers registers;
+    uint64_t cycles{};
+  } idle;
+  bool idle_skipping = true;
+  uint64_t idle_skip_limit{}; // Cycle limit of the current run(), 0 outside
+  uint64_t idle_skipped_cycles{};
+
+#ifdef NES_PROFILER
+  Profiler *profiler{};
+  CallGraph *callgraph{};
+#endif
+#ifdef NES_COVERAGE
+  CoverageMap *coverage{};
+#endif
+
+  // Call-graph hooks, the target is the new PC
+  void profileCall(uint8_t return_sp) {
+#ifdef NES_PROFILER
+    if (callgraph) {
+      callgraph->enter(ram->prgBank(reg.PC), reg.PC, return_sp, cycles);
+    }
+#endif
+  }
+  void profileReturn() {
+#ifdef NES_PROFILER
+    if (callgraph) {
+      callgraph->leave(reg.SP, cycles);
+    }
+#endif
+  }
+
+  // Coverage hook at control transfers, the target is the new PC
+  void coverEdge(uint16_t from) {
+#ifdef NES_COVERAGE
+    if (coverage) {
+      coverage->edge(from, reg.PC);
+    }
+#endif
+  }
+
   uint16_t readAddressAndIncrementPC(uint8_t mode);
   uint8_t readByteAndIncrementPC(uint8_t mode);
   uint8_t readByte(uint8_t mode);
   void writeByte(uint8_t mode, uint8_t value);
+  bool serviceInterrupts();
+  void onBackwardJump(uint16_t from);
+  bool isIdleLoopBody(uint16_t start, uint16_t end) const;
 
 public:
   explicit CPU_6502(Bus *ram);
 
   void step();
   void step(int nbSteps);
+  // Execute instructions until the cycle counter reaches cycleLimit.
+  // Idle loops (polling loops without writes) are fast-forwarded by whole
+  // iterations up to the limit, which must then be the next event.
+  void run(uint64_t cycleLimit);
+  void setIdleLoopSkipping(bool enabled) { idle_skipping = enabled; }
+  uint64_t getIdleSkippedCycles() const { return idle_skipped_cycles; }
+  uint64_t getCycles() const { return cycles; }
+  // Debug variant of run(), also stopping on the bus breakpoints and
+  // watchpoints or once predicate (checked after each instruction) holds
+  Stop runUntil(uint64_t cycleLimit, const Predicate &predicate = {});
 
   void reset();
 
+  // Registers, latched vectors and cycle count. Idle loop and breakpoint
+  // bookkeeping starts over after a load.
+  void serialize(Serializer &s);
+  // Hash of the registers, leaving out the cycle count
+  uint64_t fingerprint() const;
+
+#ifdef NES_PROFILER
+  // Count every executed instruction in the given profiler, nullptr detaches
+  void attachProfiler(Profiler *profiler) { this->profiler = profiler; }
+  // Track subroutine calls and returns in the given call graph
+  void attachCallGraph(CallGraph *callgraph) { this->callgraph = callgraph; }
+#endif
+#ifdef NES_COVERAGE
+  // Record control transfer edges in the given map, nullptr detaches
+  void attachCoverage(CoverageMap *coverage) { this->coverage = coverage; }
+#endif
+
   void printState() const;
-  Registers dumpRegisters() { return reg; };
+  Registers dumpRegisters() const { return reg; };
+  // A JAM opcode ($02, $12, ... $F2) locked the CPU up: PC stays on it and
+  // interrupts are ignored until reset()
+  bool jammed() const { return jam; }
 
   template <typename T> static std::string print_hex(T a);
 };
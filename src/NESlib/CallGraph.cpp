@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "CallGraph.h"
+
+namespace {
+
+constexpr uint32_t root_routine = 0xFFFFFFFF;
+
+std::string routineName(uint32_t routine, const SymbolTable &symbols) {
+  if (routine == root_routine) {
+    return "(root)";
+  }
+  uint16_t bank = routine >> 16;
+  std::string name = symbols.name(routine & 0xFFFF);
+  if (bank != 0) {
+    name = std::to_string(bank) + ":" + name;
+  }
+  return name;
+}
+
+} // namespace
+
+CallGraph::CallGraph() : root(std::make_unique<Node>(Node{root_routine, nullptr})) {
+  stack.push_back(Frame{root.get(), 0xFF, 0});
+}
+
+void CallGraph::account(uint64_t cycles) {
+  stack.back().node->self += cycles - last_cycles;
+  last_cycles = cycles;
+}
+
+void CallGraph::enter(uint16_t bank, uint16_t address, uint8_t sp, uint64_t cycles) {
+  account(cycles);
+  Node *parent = stack.back().node;
+  uint32_t routine = (static_cast<uint32_t>(bank) << 16) | address;
+  auto &child = parent->children[routine];
+  if (!child) {
+    child = std::make_unique<Node>(Node{routine, parent});
+  }
+  child->calls++;
+  stack.push_back(Frame{child.get(), sp, cycles});
+}
+
+void CallGraph::leave(uint8_t sp, uint64_t cycles) {
+  account(cycles);
+  // Unwind every frame entered at a deeper or equal stack level
+  while (stack.size() > 1 && stack.back().return_sp <= sp) {
+    pop(cycles);
+  }
+}
+
+void CallGraph::pop(uint64_t cycles) {
+  Frame frame = stack.back();
+  stack.pop_back();
+
+  Routine &routine = totals[frame.node->routine];
+  routine.bank = frame.node->routine >> 16;
+  routine.address = frame.node->routine & 0xFFFF;
+  routine.calls++;
+  // Recursive invocations are only counted once in the inclusive cost
+  bool recursive = std::any_of(stack.begin(), stack.end(), [&](const Frame &outer) {
+    return outer.node->routine == frame.node->routine;
+  });
+  if (!recursive) {
+    routine.inclusive += cycles - frame.entry_cycles;
+  }
+}
+
+std::vector<CallGraph::Routine> CallGraph::routines() const {
+  std::map<uint32_t, Routine> result = totals;
+
+  // Routines still on the stack, counted as if they returned now
+  for (std::size_t i = 1; i < stack.size(); i++) {
+    const Frame &frame = stack[i];
+    Routine &routine = result[frame.node->routine];
+    routine.bank = frame.node->routine >> 16;
+    routine.address = frame.node->routine & 0xFFFF;
+    routine.calls++;
+    bool recursive = std::any_of(stack.begin(), stack.begin() + i, [&](const Frame &outer) {
+      return outer.node->routine == frame.node->routine;
+    });
+    if (!recursive) {
+      routine.inclusive += last_cycles - frame.entry_cycles;
+    }
+  }
+
+  // Exclusive costs come from the tree so routines still on the stack count
+  std::vector<const Node *> pending{root.get()};
+  while (!pending.empty()) {
+    const Node *node = pending.back();
+    pending.pop_back();
+    if (node != root.get()) {
+      Routine &routine = result[node->routine];
+      routine.bank = node->routine >> 16;
+      routine.address = node->routine & 0xFFFF;
+      routine.exclusive += node->self;
+    }
+    for (const auto &child : node->children) {
+      pending.push_back(child.second.get());
+    }
+  }
+
+  std::vector<Routine> sorted;
+  for (const auto &entry : result) {
+    sorted.push_back(entry.second);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Routine &a, const Routine &b) { return a.inclusive > b.inclusive; });
+  return sorted;
+}
+
+void CallGraph::report(std::ostream &out, const SymbolTable &symbols, std::size_t top) const {
+  char line[160];
+  std::snprintf(line, sizeof(line), "%-24s %10s %14s %14s\n", "routine", "calls", "inclusive",
+                "exclusive");
+  out << line;
+  auto sorted = routines();
+  for (std::size_t i = 0; i < std::min(top, sorted.size()); i++) {
+    const Routine &routine = sorted[i];
+    uint32_t key = (static_cast<uint32_t>(routine.bank) << 16) | routine.address;
+    std::snprintf(line, sizeof(line), "%-24s %10llu %14llu %14llu\n",
+                  routineName(key, symbols).c_str(),
+                  static_cast<unsigned long long>(routine.calls),
+                  static_cast<unsigned long long>(routine.inclusive),
+                  static_cast<unsigned long long>(routine.exclusive));
+    out << line;
+  }
+}
+
+void CallGraph::exportCollapsed(std::ostream &out, const SymbolTable &symbols) const {
+  // Depth-first walk carrying the path of names down to each node
+  struct Visit {
+    const Node *node;
+    std::string path;
+  };
+  std::vector<Visit> pending{{root.get(), routineName(root_routine, symbols)}};
+  while (!pending.empty()) {
+    Visit visit = std::move(pending.back());
+    pending.pop_back();
+    if (visit.node->self != 0) {
+      out << visit.path << ' ' << visit.node->self << '\n';
+    }
+    for (const auto &child : visit.node->children) {
+      pending.push_back(
+          Visit{child.second.get(), visit.path + ";" + routineName(child.first, symbols)});
+    }
+  }
+}
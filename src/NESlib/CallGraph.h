@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "Symbols.h"
+
+/**
+ Guest call-graph profiler.
+
+ CPU_6502 (built with NES_PROFILER) reports subroutine entries (JSR, BRK,
+ interrupts) and returns (RTS, RTI). A shadow call stack attributes the
+ cycles elapsed between two such events to the routine on top, building a
+ call tree from which inclusive and exclusive costs per routine and
+ collapsed stacks for flamegraph tools are derived.
+
+ Routines are identified by their bank-qualified entry address. Returns
+ unwind every frame whose stack pointer is at or below the one restored,
+ so routines dropping their return address (PLA PLA, RTS tricks) do not
+ desynchronize the shadow stack.
+ */
+class CallGraph {
+public:
+  CallGraph();
+
+  // sp is the stack pointer before the return address was pushed, which
+  // the matching RTS/RTI restores
+  void enter(uint16_t bank, uint16_t address, uint8_t sp, uint64_t cycles);
+  void leave(uint8_t sp, uint64_t cycles);
+
+  struct Routine {
+    uint16_t bank;
+    uint16_t address;
+    uint64_t calls{};
+    uint64_t inclusive{};
+    uint64_t exclusive{};
+  };
+  // Costs per routine, sorted by decreasing inclusive cycles. Routines
+  // still on the shadow stack count up to the last call or return.
+  std::vector<Routine> routines() const;
+  std::size_t depth() const { return stack.size() - 1; }
+
+  void report(std::ostream &out, const SymbolTable &symbols = {}, std::size_t top = 30) const;
+  // One "caller;callee;... exclusive_cycles" line per call path
+  void exportCollapsed(std::ostream &out, const SymbolTable &symbols = {}) const;
+
+private:
+  struct Node {
+    uint32_t routine; // bank << 16 | address
+    Node *parent;
+    uint64_t calls{};
+    uint64_t self{};
+    std::map<uint32_t, std::unique_ptr<Node>> children;
+  };
+  struct Frame {
+    Node *node;
+    uint8_t return_sp;
+    uint64_t entry_cycles;
+  };
+
+  void account(uint64_t cycles);
+  void pop(uint64_t cycles);
+
+  std::unique_ptr<Node> root;
+  std::vector<Frame> stack;
+  uint64_t last_cycles{};
+  std::map<uint32_t, Routine> totals;
+};
@@ -1,50 +1,152 @@
 #include "Cartridge.h"
+#include "Log.h"
 #include <fstream>
 #include <ios>
+#include <utility>
 #include <vector>
 #include <string>
-#include <iomanip>
-#include <iostream>
 
+namespace {
 
-std::string print_hex(uint8_t a) {
-    std::stringstream ss;
-    ss << "0x" << std::setw(2*sizeof(a)) << std::setfill('0') << std::hex << (int) a;
-    return ss.str();
+/**
+ * NES 2.0 ROM sizes: when the MSB nibble is $F, the LSB byte is an
+ * exponent-multiplier pair (EEEEEEMM) giving 2^E * (MM*2+1) bytes.
+ */
+std::size_t romSize(uint8_t lsb, uint8_t msb, std::size_t unit) {
+    if (msb == 0xF) {
+        uint8_t exponent = lsb >> 2;
+        uint8_t multiplier = lsb & 0b11;
+        if (exponent > 40) {
+            throw CartridgeError(CartridgeError::Kind::Corrupt,
+                                 "ROM size exponent out of range");
+        }
+        return (std::size_t{1} << exponent) * (multiplier * 2 + 1);
+    }
+    return ((msb << 8) | lsb) * unit;
 }
 
-Cartridge::Cartridge(const std::string &filename) {
-    std::ifstream file(filename,std::ios_base::binary|std::ios_base::in);
-    std::vector<uint8_t>header(0x10,0);
-    file.read(reinterpret_cast<char*>(&header[0]),0x10);
-
-    // First 3 bytes should be "NES" in ASCII
-    if (header[0] == 0x4e && header[1] == 0x45 && header[2] == 0x53 && header[3] == 0x1a) {
-        std::cout << "NES file identified" << std::endl;
-    } // TODO : exception
-
-    auto PRG_ROM_size = header[4];
-    auto CHR_ROM_size = header[5];
-    auto flags6 = header[6];
-    auto flags7 = header[7];
-    auto flags8 = header[8];
-    auto flags9 = header[9];
-    auto flags10 = header[10];
+// NES 2.0 RAM sizes are shift counts: 64 << n bytes, 0 meaning none
+std::size_t ramSize(uint8_t shift) {
+    return shift == 0 ? 0 : std::size_t{64} << shift;
+}
+
+} // namespace
+
+CartridgeHeader CartridgeHeader::parse(const uint8_t *raw, std::size_t file_size) {
+    if (file_size < CartridgeHeader::size) {
+        throw CartridgeError(CartridgeError::Kind::Truncated, "File is smaller than an iNES header");
+    }
+
+    // First 4 bytes should be "NES" followed by MS-DOS end-of-file
+    if (raw[0] != 0x4e || raw[1] != 0x45 || raw[2] != 0x53 || raw[3] != 0x1a) {
+        throw CartridgeError(CartridgeError::Kind::BadMagic, "Missing iNES signature");
+    }
+
+    auto flags6 = raw[6];
+    auto flags7 = raw[7];
+
+    CartridgeHeader header;
+    header.nes2 = (flags7 & 0x0C) == 0x08;
+    header.battery = flags6 & 0x02;
+    header.trainer = flags6 & 0x04;
+    if (flags6 & 0x08) {
+        header.mirroring = Mirroring::FourScreen;
+    } else {
+        header.mirroring = (flags6 & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+    }
 
     // Bits 4-7 of both ROM control bytes represent the mapper number upper and lower bits
-    uint8_t mapper = (flags6 >> 4) | (flags7 & 0xF0);
+    header.mapper = (flags6 >> 4) | (flags7 & 0xF0);
+
+    if (header.nes2) {
+        header.mapper |= (raw[8] & 0x0F) << 8;
+        header.submapper = raw[8] >> 4;
+        header.console_type = flags7 & 0x03;
+        header.prg_rom_size = romSize(raw[4], raw[9] & 0x0F, 0x4000);
+        header.chr_rom_size = romSize(raw[5], raw[9] >> 4, 0x2000);
+        header.prg_ram_size = ramSize(raw[10] & 0x0F);
+        header.prg_nvram_size = ramSize(raw[10] >> 4);
+        header.chr_ram_size = ramSize(raw[11] & 0x0F);
+        header.chr_nvram_size = ramSize(raw[11] >> 4);
+        header.timing = raw[12] & 0x03;
+    } else {
+        // Archaic dumpers wrote their name in bytes 7-15 ("DiskDude!"),
+        // in which case the upper mapper nibble is garbage.
+        if (raw[12] != 0 || raw[13] != 0 || raw[14] != 0 || raw[15] != 0) {
+            header.mapper &= 0x0F;
+        }
+        header.console_type = flags7 & 0x03;
+        header.prg_rom_size = raw[4] * 0x4000;
+        header.chr_rom_size = raw[5] * 0x2000;
+        // A zero value in byte 8 infers 8kB for compatibility
+        std::size_t prg_ram = (raw[8] == 0 ? 1 : raw[8]) * 0x2000;
+        if (header.battery) {
+            header.prg_nvram_size = prg_ram;
+        } else {
+            header.prg_ram_size = prg_ram;
+        }
+        header.chr_ram_size = header.chr_rom_size == 0 ? 0x2000 : 0;
+        header.timing = raw[9] & 0x01;
+    }
 
-    std::cout << "PRG ROM size = " << print_hex(PRG_ROM_size) << " * 16kB\n";
-    std::cout << "CHR ROM size = " << print_hex(CHR_ROM_size) << " * 8kB\n";
-    std::cout << "Mapper :  " << print_hex(mapper) << std::endl;
+    if (header.prg_rom_size == 0) {
+        throw CartridgeError(CartridgeError::Kind::Corrupt, "Header declares no PRG ROM");
+    }
 
+    std::size_t expected = CartridgeHeader::size + (header.trainer ? CartridgeHeader::trainer_size : 0) +
+                           header.prg_rom_size + header.chr_rom_size;
+    if (file_size < expected) {
+        throw CartridgeError(CartridgeError::Kind::Truncated,
+                             "File holds " + std::to_string(file_size) + " bytes, header declares " +
+                             std::to_string(expected));
+    }
 
-    // Load PRG & CHR ROM
-    prg_rom.resize(0x4000 * PRG_ROM_size,0);
-    file.read(reinterpret_cast<char*>(&prg_rom[0]),0x4000 * PRG_ROM_size);
+    return header;
+}
+
+Cartridge::Cartridge(const std::string &filename) {
+    std::ifstream file(filename, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
+    if (!file) {
+        throw CartridgeError(CartridgeError::Kind::FileNotFound, "Cannot open " + filename);
+    }
+    auto file_size = static_cast<std::size_t>(file.tellg());
+    file.seekg(0);
+
+    std::vector<uint8_t> image(file_size);
+    file.read(reinterpret_cast<char*>(image.data()), file_size);
+    load(std::move(image), filename);
+}
+
+Cartridge::Cartridge(std::span<const uint8_t> image, const std::string &name)
+    : Cartridge(std::vector<uint8_t>(image.begin(), image.end()), name) {}
+
+Cartridge::Cartridge(std::vector<uint8_t> &&image, const std::string &name) {
+    load(std::move(image), name);
+}
+
+void Cartridge::load(std::vector<uint8_t> &&image, const std::string &name) {
+    header = CartridgeHeader::parse(image.data(), image.size());
+    std::size_t offset = CartridgeHeader::size;
+
+    if (header.trainer) {
+        trainer.assign(image.begin() + offset, image.begin() + offset + CartridgeHeader::trainer_size);
+        offset += CartridgeHeader::trainer_size;
+    }
+
+    // CHR ROM is copied out, PRG ROM takes over the image buffer
+    std::size_t chr_offset = offset + header.prg_rom_size;
+    chr_rom.assign(image.begin() + chr_offset, image.begin() + chr_offset + header.chr_rom_size);
+    image.resize(chr_offset);
+    image.erase(image.begin(), image.begin() + offset);
+    prg_rom = std::move(image);
+
+    logLoaded(name);
+}
 
-    chr_rom.resize(0x4000 * CHR_ROM_size,0);
-    file.read(reinterpret_cast<char*>(&chr_rom[0]),0x4000 * CHR_ROM_size);
+void Cartridge::logLoaded(const std::string &name) const {
+    NES_LOG_INFO(LogCategory::CARTRIDGE, "%s: %s, mapper %u, PRG ROM %zukB, CHR ROM %zukB",
+                 name.c_str(), header.nes2 ? "NES 2.0" : "iNES", header.mapper,
+                 header.prg_rom_size / 1024, header.chr_rom_size / 1024);
 }
 
 const std::vector<uint8_t>& Cartridge::getPRG_ROM() {
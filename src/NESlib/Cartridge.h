@@ -1,24 +1,97 @@
 #ifndef NES_CARTRIDGE_H
 #define NES_CARTRIDGE_H
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+enum class Mirroring { Horizontal, Vertical, FourScreen };
+
 /**
- Reads iNES files
+ Decoded iNES / NES 2.0 header.
+ https://www.nesdev.org/wiki/INES
+ https://www.nesdev.org/wiki/NES_2.0
+
+ All sizes are expressed in bytes.
+ */
+struct CartridgeHeader {
+    bool nes2 = false;
+    uint16_t mapper = 0;
+    uint8_t submapper = 0;
+
+    Mirroring mirroring = Mirroring::Horizontal;
+    bool battery = false;
+    bool trainer = false;
+
+    std::size_t prg_rom_size = 0;
+    std::size_t chr_rom_size = 0;
+    std::size_t prg_ram_size = 0;
+    std::size_t prg_nvram_size = 0;
+    std::size_t chr_ram_size = 0;
+    std::size_t chr_nvram_size = 0;
+
+    uint8_t console_type = 0; // 0: NES/Famicom, 1: Vs. System, 2: Playchoice, 3: extended
+    uint8_t timing = 0;       // 0: NTSC, 1: PAL, 2: multi-region, 3: Dendy
+
+    static constexpr std::size_t size = 0x10;
+    static constexpr std::size_t trainer_size = 0x200;
+
+    /**
+     * Decode the 16 bytes header of a ROM image. file_size is the size of the
+     * whole image, used to reject truncated files before reading them.
+     * Throws CartridgeError on any inconsistency.
+     */
+    static CartridgeHeader parse(const uint8_t *raw, std::size_t file_size);
+};
+
+/**
+ Raised when a ROM image cannot be loaded. kind() allows callers to react
+ without parsing the message.
+ */
+class CartridgeError : public std::runtime_error {
+public:
+    enum class Kind { FileNotFound, BadMagic, Truncated, Corrupt, UnsupportedMapper };
+
+    CartridgeError(Kind kind, const std::string &message)
+        : std::runtime_error(message), error_kind(kind) {};
+
+    Kind kind() const { return error_kind; }
+
+private:
+    Kind error_kind;
+};
+
+/**
+ Reads iNES files, from disk or from an image already in memory. The
+ memory constructors parse the same way and do no I/O, name only appears
+ in the log.
  */
 class Cartridge {
 public:
-  explicit Cartridge(const std::string& filename);
-  Cartridge(Cartridge& cartridge) = delete;
+    explicit Cartridge(const std::string& filename);
+    // Copies image, which can be released afterwards
+    explicit Cartridge(std::span<const uint8_t> image, const std::string& name = "<memory>");
+    // Takes over image, PRG ROM reuses its storage
+    explicit Cartridge(std::vector<uint8_t>&& image, const std::string& name = "<memory>");
+    Cartridge(Cartridge& cartridge) = delete;
 
-  bool extended();
-  const std::vector<uint8_t>& getPRG_ROM();
-  const std::vector<uint8_t>& getCHR_ROM();
+    bool extended();
+    const CartridgeHeader& getHeader() const { return header; }
+    const std::vector<uint8_t>& getPRG_ROM();
+    const std::vector<uint8_t>& getCHR_ROM();
+    const std::vector<uint8_t>& getTrainer() const { return trainer; }
 private:
-  std::vector<uint8_t> prg_rom;
-  std::vector<uint8_t> chr_rom;
+    void load(std::vector<uint8_t>&& image, const std::string& name);
+    void logLoaded(const std::string& name) const;
+
+    CartridgeHeader header;
+    std::vector<uint8_t> prg_rom;
+    std::vector<uint8_t> chr_rom;
+    std::vector<uint8_t> trainer;
 };
 
 
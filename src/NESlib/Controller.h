@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Serializer.h"
+
+/**
+ Standard controller, read serially through $4016 / $4017.
+ https://www.nesdev.org/wiki/Standard_controller
+
+ Writing 1 then 0 to $4016 latches the buttons into a shift register,
+ each read returns the next button in A, B, Select, Start, Up, Down, Left,
+ Right order, then 1s once all 8 have been shifted out.
+ */
+class Controller {
+public:
+  enum Button : uint8_t {
+    A = 1 << 0,
+    B = 1 << 1,
+    SELECT = 1 << 2,
+    START = 1 << 3,
+    UP = 1 << 4,
+    DOWN = 1 << 5,
+    LEFT = 1 << 6,
+    RIGHT = 1 << 7,
+  };
+
+  void setButtons(uint8_t pressed) { buttons = pressed; }
+  uint8_t getButtons() const { return buttons; }
+
+  void strobe(uint8_t value) {
+    // The shift register keeps reloading while the strobe is high
+    if (latching || (value & 1)) {
+      shift = buttons;
+    }
+    latching = value & 1;
+  }
+
+  uint8_t read() {
+    if (latching) {
+      return buttons & A;
+    }
+    uint8_t bit = shift & 1;
+    shift = (shift >> 1) | 0x80;
+    return bit;
+  }
+
+  // Buttons and shift register, see NES::fingerprint
+  uint32_t fingerprint() const { return buttons | (shift << 8) | (latching << 16); }
+
+  void serialize(Serializer &s) {
+    s.value(buttons);
+    s.value(shift);
+    s.value(latching);
+  }
+
+private:
+  uint8_t buttons{};
+  uint8_t shift{};
+  bool latching{};
+};
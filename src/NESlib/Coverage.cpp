@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/shm.h>
+
+#include "Coverage.h"
+
+namespace {
+
+std::size_t checkSize(std::size_t size) {
+  if (size == 0 || (size & (size - 1)) != 0) {
+    throw std::invalid_argument("Coverage map size must be a power of two");
+  }
+  return size;
+}
+
+} // namespace
+
+CoverageMap::CoverageMap(std::size_t size) : owned(checkSize(size)) {
+  map = owned.data();
+  mask = size - 1;
+}
+
+CoverageMap::CoverageMap(uint8_t *map, std::size_t size) : map(map), mask(checkSize(size) - 1) {}
+
+CoverageMap::~CoverageMap() {
+  if (shared) {
+    shmdt(shared);
+  }
+}
+
+std::unique_ptr<CoverageMap> CoverageMap::fromAFLEnvironment() {
+  const char *id = std::getenv("__AFL_SHM_ID");
+  if (!id) {
+    return nullptr;
+  }
+  void *segment = shmat(std::atoi(id), nullptr, 0);
+  if (segment == reinterpret_cast<void *>(-1)) {
+    throw std::runtime_error(std::string("Cannot attach AFL shared memory: ") + std::strerror(errno));
+  }
+  auto coverage = std::make_unique<CoverageMap>(static_cast<uint8_t *>(segment), DEFAULT_SIZE);
+  coverage->shared = segment;
+  return coverage;
+}
+
+std::size_t CoverageMap::edges() const {
+  return size() - std::count(map, map + size(), 0);
+}
+
+void CoverageMap::clear() { std::memset(map, 0, size()); }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ AFL-style edge coverage of guest code, feedback for coverage-guided
+ fuzzers.
+
+ CPU_6502 records one edge per control transfer (branches taken or not,
+ jumps, calls, returns, interrupts) when built with NES_COVERAGE and a map
+ is attached; without NES_COVERAGE the hook is compiled out. An edge
+ (from, to) bumps the 8-bit counter at
+   (location(from) ^ location(to) >> 1) mod size
+ as AFL does, the shift telling A -> B apart from B -> A.
+
+ The map can be owned, borrowed from an in-process fuzzer (libFuzzer extra
+ counters, a custom driver), or attached to the shared memory segment an
+ AFL parent passes in __AFL_SHM_ID.
+ */
+class CoverageMap {
+public:
+  static constexpr std::size_t DEFAULT_SIZE = 1 << 16; // AFL MAP_SIZE
+
+  // Owned map, size is a power of two
+  explicit CoverageMap(std::size_t size = DEFAULT_SIZE);
+  // Caller's map, size is a power of two
+  CoverageMap(uint8_t *map, std::size_t size);
+  ~CoverageMap();
+  CoverageMap(const CoverageMap &) = delete;
+  CoverageMap &operator=(const CoverageMap &) = delete;
+
+  // Map shared by an AFL parent process, nullptr when not run by AFL.
+  // Throws std::runtime_error when the segment cannot be attached.
+  static std::unique_ptr<CoverageMap> fromAFLEnvironment();
+
+  void edge(uint16_t from, uint16_t to) { map[(location(from) ^ (location(to) >> 1)) & mask]++; }
+
+  uint8_t *data() { return map; }
+  const uint8_t *data() const { return map; }
+  std::size_t size() const { return mask + 1; }
+  // Counters hit at least once
+  std::size_t edges() const;
+  void clear();
+
+private:
+  // Scattered 16-bit id of a guest address
+  static uint32_t location(uint16_t pc) { return (pc * 0x9E3779B1u) >> 16; }
+
+  uint8_t *map;
+  std::size_t mask;
+  std::vector<uint8_t> owned;
+  void *shared{}; // Attached segment, detached on destruction
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ One bit per block of a memory, set when the block is written.
+
+ Marking costs a shift and an OR, so it can sit on every write path.
+ Consumers visit the dirty blocks with forEach, then clear the bitmap
+ (harvest does both), and only touch what changed since.
+ */
+template <std::size_t Size, std::size_t Block> class DirtyBitmap {
+public:
+  static constexpr std::size_t SIZE = Size;
+  static constexpr std::size_t BLOCK = Block;
+  static constexpr std::size_t BLOCKS = (Size + Block - 1) / Block;
+
+  void mark(std::size_t offset) {
+    std::size_t block = offset / Block;
+    words[block / 64] |= uint64_t{1} << (block % 64);
+  }
+  void mark(std::size_t offset, std::size_t size) {
+    for (std::size_t block = offset / Block; block <= (offset + size - 1) / Block; block++) {
+      words[block / 64] |= uint64_t{1} << (block % 64);
+    }
+  }
+  void markAll() {
+    for (std::size_t block = 0; block < BLOCKS; block++) {
+      words[block / 64] |= uint64_t{1} << (block % 64);
+    }
+  }
+
+  bool test(std::size_t block) const { return words[block / 64] >> (block % 64) & 1; }
+  bool any() const {
+    for (uint64_t word : words) {
+      if (word) {
+        return true;
+      }
+    }
+    return false;
+  }
+  std::size_t count() const {
+    std::size_t total = 0;
+    for (uint64_t word : words) {
+      total += std::popcount(word);
+    }
+    return total;
+  }
+
+  // Calls f(block) for each dirty block, in increasing order
+  template <typename F> void forEach(F &&f) const {
+    for (std::size_t i = 0; i < words.size(); i++) {
+      for (uint64_t word = words[i]; word; word &= word - 1) {
+        f(i * 64 + std::countr_zero(word));
+      }
+    }
+  }
+
+  // Visit then clear the dirty blocks
+  template <typename F> void harvest(F &&f) {
+    forEach(f);
+    clear();
+  }
+
+  void clear() { words.fill(0); }
+
+private:
+  std::array<uint64_t, (BLOCKS + 63) / 64> words{};
+};
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileLoader.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define NES_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Reads larger than this are split, the kernel caps a read at 2GB
+constexpr std::size_t MAX_READ = std::size_t{1} << 30;
+
+#ifdef NES_IO_URING
+int ioUringSetup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned submit, unsigned complete, unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0));
+}
+
+unsigned *at(void *base, unsigned offset) {
+  return reinterpret_cast<unsigned *>(static_cast<char *>(base) + offset);
+}
+#endif
+
+} // namespace
+
+FileLoader::FileLoader(unsigned queue_depth) {
+  if (!setup(std::max(queue_depth, 1u))) {
+    ring = Ring{};
+  }
+}
+
+FileLoader::~FileLoader() {
+  // The kernel still writes to the buffers of reads in flight, the
+  // pending files are left unopened
+  pending.clear();
+  try {
+    flush();
+    while (in_flight > 0) {
+      reap();
+    }
+  } catch (const std::runtime_error &) {
+    // Nothing left to submit or reap
+  }
+  for (Request &request : requests) {
+    close(request);
+  }
+#ifdef NES_IO_URING
+  if (ring.fd >= 0) {
+    munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq != ring.sq) {
+      munmap(ring.cq, ring.cq_size);
+    }
+    munmap(ring.sq, ring.sq_size);
+    ::close(ring.fd);
+  }
+#endif
+}
+
+bool FileLoader::setup(unsigned queue_depth) {
+#ifdef NES_IO_URING
+  io_uring_params params{};
+  ring.fd = ioUringSetup(queue_depth, &params);
+  if (ring.fd < 0) {
+    return false;
+  }
+  ring.entries = params.sq_entries;
+  ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) {
+    ring.sq_size = ring.cq_size = std::max(ring.sq_size, ring.cq_size);
+  }
+
+  ring.sq = mmap(nullptr, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                 IORING_OFF_SQ_RING);
+  if (ring.sq == MAP_FAILED) {
+    ::close(ring.fd);
+    return false;
+  }
+  ring.cq = single ? ring.sq
+                   : mmap(nullptr, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                          IORING_OFF_CQ_RING);
+  ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  ring.sqes = ring.cq == MAP_FAILED ? MAP_FAILED
+                                    : mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED) {
+    if (ring.cq != MAP_FAILED && !single) {
+      munmap(ring.cq, ring.cq_size);
+    }
+    munmap(ring.sq, ring.sq_size);
+    ::close(ring.fd);
+    return false;
+  }
+
+  ring.sq_head = at(ring.sq, params.sq_off.head);
+  ring.sq_tail = at(ring.sq, params.sq_off.tail);
+  ring.sq_mask = at(ring.sq, params.sq_off.ring_mask);
+  ring.sq_array = at(ring.sq, params.sq_off.array);
+  ring.cq_head = at(ring.cq, params.cq_off.head);
+  ring.cq_tail = at(ring.cq, params.cq_off.tail);
+  ring.cq_mask = at(ring.cq, params.cq_off.ring_mask);
+  ring.cqes = at(ring.cq, params.cq_off.cqes);
+  return true;
+#else
+  (void)queue_depth;
+  return false;
+#endif
+}
+
+std::size_t FileLoader::submit(const std::string &path) {
+  std::size_t ticket = requests.size();
+  requests.emplace_back().path = path;
+  if (asynchronous()) {
+    pending.push_back(ticket);
+    start();
+  }
+  return ticket;
+}
+
+bool FileLoader::open(Request &request) {
+  request.fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat status {};
+  if (request.fd < 0 || fstat(request.fd, &status) != 0) {
+    request.error = errno;
+  } else {
+    request.data.resize(static_cast<std::size_t>(status.st_size));
+  }
+  if (request.error != 0 || request.data.empty()) {
+    close(request);
+    request.finished = true;
+    return false;
+  }
+  return true;
+}
+
+void FileLoader::start() {
+  while (asynchronous() && !pending.empty() && queued + in_flight < ring.entries) {
+    std::size_t ticket = pending.front();
+    pending.pop_front();
+    if (open(requests[ticket])) {
+      queue(ticket);
+    }
+  }
+}
+
+void FileLoader::queue(std::size_t ticket) {
+#ifdef NES_IO_URING
+  Request &request = requests[ticket];
+  unsigned tail = *ring.sq_tail;
+  unsigned index = tail & *ring.sq_mask;
+  auto *sqe = static_cast<io_uring_sqe *>(ring.sqes) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = request.fd;
+  sqe->addr = reinterpret_cast<uint64_t>(request.data.data() + request.done);
+  sqe->len = static_cast<uint32_t>(std::min(request.data.size() - request.done, MAX_READ));
+  sqe->off = request.done;
+  sqe->user_data = ticket;
+  ring.sq_array[index] = index;
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  request.in_flight = true;
+  queued++;
+#else
+  (void)ticket;
+#endif
+}
+
+void FileLoader::flush() {
+#ifdef NES_IO_URING
+  start();
+  while (queued > 0) {
+    int submitted = ioUringEnter(ring.fd, queued, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        reap();
+        continue;
+      }
+      throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+    }
+    queued -= submitted;
+    in_flight += submitted;
+  }
+#endif
+}
+
+void FileLoader::reap() {
+#ifdef NES_IO_URING
+  unsigned head = *ring.cq_head;
+  if (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+    if (ioUringEnter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+    }
+  }
+
+  unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+  std::vector<std::size_t> again;
+  for (; head != tail; head++) {
+    const auto &cqe = static_cast<io_uring_cqe *>(ring.cqes)[head & *ring.cq_mask];
+    Request &request = requests[cqe.user_data];
+    request.in_flight = false;
+    in_flight--;
+    if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+      // IORING_OP_READ needs Linux 5.6, wait() reads with pread instead
+      rejected = true;
+      close(request);
+      request.done = 0;
+      request.data.clear();
+    } else if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+      again.push_back(cqe.user_data);
+    } else if (cqe.res < 0) {
+      request.error = -cqe.res;
+      request.finished = true;
+    } else if (cqe.res == 0) {
+      // The file shrank since it was opened
+      request.data.resize(request.done);
+      request.finished = true;
+    } else {
+      request.done += static_cast<std::size_t>(cqe.res);
+      request.finished = request.done == request.data.size();
+      if (!request.finished) {
+        again.push_back(cqe.user_data);
+      }
+    }
+    if (request.finished) {
+      close(request);
+    }
+  }
+  __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+  // Each of these freed its own slot
+  for (std::size_t ticket : again) {
+    queue(ticket);
+  }
+  start();
+#endif
+}
+
+void FileLoader::readSynchronously(Request &request) {
+  if (!open(request)) {
+    return;
+  }
+  while (request.done < request.data.size()) {
+    ssize_t count = pread(request.fd, request.data.data() + request.done,
+                          std::min(request.data.size() - request.done, MAX_READ), static_cast<off_t>(request.done));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      request.error = errno;
+      break;
+    }
+    if (count == 0) {
+      request.data.resize(request.done);
+      break;
+    }
+    request.done += static_cast<std::size_t>(count);
+  }
+  close(request);
+  request.finished = true;
+}
+
+std::vector<uint8_t> FileLoader::wait(std::size_t ticket) {
+  if (ticket >= requests.size() || requests[ticket].returned) {
+    throw std::runtime_error("FileLoader: unknown or already returned ticket");
+  }
+  Request &request = requests[ticket];
+  while (!request.finished) {
+    if (request.in_flight) {
+      flush();
+      reap();
+    } else if (!asynchronous()) {
+      readSynchronously(request);
+    } else {
+      // Still pending, start it or wait for a slot
+      flush();
+      if (!request.finished && in_flight > 0) {
+        reap();
+      }
+    }
+  }
+  request.returned = true;
+  if (request.error != 0) {
+    throw std::runtime_error("Cannot read " + request.path + ": " + std::strerror(request.error));
+  }
+  return std::move(request.data);
+}
+
+void FileLoader::close(Request &request) {
+  if (request.fd >= 0) {
+    ::close(request.fd);
+    request.fd = -1;
+  }
+}
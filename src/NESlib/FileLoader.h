@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ Reads whole files asynchronously, for batch starts loading many ROMs and
+ states, see NES::fromFiles.
+
+ submit() queues a file, wait() returns its contents. Reads go through an
+ io_uring set up with raw syscalls, no liburing: the queued reads start
+ together at the next flush() or wait(), and finish while the caller works
+ on the files it already has. A file is only open while its read is in the
+ ring, so at most queue_depth files are open whatever the number
+ submitted. When io_uring is unavailable (old kernel, seccomp, non-Linux),
+ wait() falls back to pread.
+
+ Not thread safe; buffers of reads in flight belong to the kernel until
+ wait() or the destructor reaps them.
+ */
+class FileLoader {
+public:
+  explicit FileLoader(unsigned queue_depth = 64);
+  ~FileLoader();
+  FileLoader(const FileLoader &) = delete;
+  FileLoader &operator=(const FileLoader &) = delete;
+
+  // Queue a read of the whole file, returns the ticket to wait() on.
+  // Failures to open are reported by wait().
+  std::size_t submit(const std::string &path);
+  // Start the queued reads
+  void flush();
+  // Contents of a submitted file, once per ticket. Throws
+  // std::runtime_error when the file cannot be read.
+  std::vector<uint8_t> wait(std::size_t ticket);
+
+  // False when reads fall back to pread
+  bool asynchronous() const { return ring.fd >= 0 && !rejected; }
+
+private:
+  struct Request {
+    std::string path;
+    int fd = -1;
+    int error = 0;
+    std::vector<uint8_t> data;
+    std::size_t done = 0;
+    bool in_flight = false;
+    bool finished = false;
+    bool returned = false;
+  };
+
+  struct Ring {
+    int fd = -1;
+    unsigned entries = 0;
+    void *sq = nullptr;
+    std::size_t sq_size = 0;
+    void *cq = nullptr;
+    std::size_t cq_size = 0;
+    void *sqes = nullptr;
+    std::size_t sqes_size = 0;
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    void *cqes = nullptr;
+  };
+
+  bool setup(unsigned queue_depth);
+  // Open pending files while the ring has free slots
+  void start();
+  // Open the file and size its buffer, false when done already (error or
+  // empty file)
+  bool open(Request &request);
+  void queue(std::size_t ticket);
+  // Handle completions, waiting for one if there are none
+  void reap();
+  void readSynchronously(Request &request);
+  void close(Request &request);
+
+  Ring ring;
+  std::vector<Request> requests;
+  std::deque<std::size_t> pending; // Submitted, not opened yet
+  bool rejected = false;           // The kernel has no IORING_OP_READ
+  unsigned queued = 0;    // SQEs not yet submitted
+  unsigned in_flight = 0; // Submitted, not reaped
+};
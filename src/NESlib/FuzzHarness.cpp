@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <exception>
+
+#include "FuzzHarness.h"
+
+namespace {
+
+constexpr uint64_t MASTER_CYCLES_PER_SCANLINE = 341 * Scheduler::PPU_DIVIDER;
+
+} // namespace
+
+FuzzHarness::FuzzHarness(std::shared_ptr<NES> machine, Options options)
+    : nes(std::move(machine)), options(options) {
+  NES::FrameOptions frame = nes->getFrameOptions();
+  frame.render = options.render;
+  nes->setFrameOptions(frame);
+  for (unsigned i = 0; i < options.boot_frames; i++) {
+    nes->runFrame();
+  }
+  nes->saveState(snapshot);
+}
+
+FuzzHarness::Result FuzzHarness::run(const uint8_t *data, std::size_t size) {
+  runs++;
+  nes->resetState(snapshot);
+
+  Result result;
+  CPU_6502 &cpu = nes->getCPU();
+  try {
+    for (std::size_t i = 0; i < std::min(size, options.max_steps); i++) {
+      if (options.step_scanlines == 0) {
+        nes->step(data[i]);
+      } else {
+        nes->getBus().controller(0).setButtons(data[i]);
+        nes->runUntil(nes->masterClock() + options.step_scanlines * MASTER_CYCLES_PER_SCANLINE);
+      }
+      result.steps++;
+      if (cpu.jammed()) {
+        result.outcome = Outcome::Jam;
+        result.pc = cpu.dumpRegisters().PC;
+        break;
+      }
+    }
+  } catch (const std::exception &e) {
+    result.outcome = Outcome::Exception;
+    result.message = e.what();
+  }
+  return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NES.h"
+
+/**
+ In-process fuzz target running many cases on one machine.
+
+ The machine is booted once and snapshotted. Each case starts from the
+ snapshot through NES::resetState, which only copies back the memory
+ blocks the previous case wrote, instead of rebuilding the cartridge,
+ mapper, bus and CPU.
+
+ A case is a controller stream: one byte per step, the controller 1
+ buttons held during it. A step is a frame (NES::step) by default, or
+ step_scanlines scanlines. A case stops at the first JAM opcode, and
+ exceptions thrown by the emulator are caught and reported. Sanitizer
+ reports abort the process, see the nesfuzz driver.
+
+ Throughput is bounded by emulation, not by the reset. A frame is about
+ 30k CPU cycles, ~40us in a Release build, so frame steps run ~25k
+ one-step cases per second per core, ~400 at the default max_steps and
+ ~40 at 600 steps. Hundreds of thousands of execs/s need shorter inputs:
+ with step_scanlines = 1, one-byte cases run at ~1M execs/s and 60-byte
+ cases at ~50k.
+ */
+class FuzzHarness {
+public:
+  struct Options {
+    // Frames run after power-up, before the snapshot
+    unsigned boot_frames = 0;
+    // Steps run at most per case, longer cases are cut
+    std::size_t max_steps = 60;
+    // Render frames, only useful when checking the picture
+    bool render = false;
+    // Scanlines each input byte is held for, 0 for a whole NES::step
+    unsigned step_scanlines = 0;
+  };
+
+  enum class Outcome { Ok, Jam, Exception };
+
+  struct Result {
+    Outcome outcome = Outcome::Ok;
+    std::size_t steps = 0; // Steps completed
+    uint16_t pc = 0;       // Address of the JAM opcode
+    std::string message;   // What the exception said
+  };
+
+  // Boots the machine, exceptions thrown while booting are not caught
+  FuzzHarness(std::shared_ptr<NES> machine, Options options);
+
+  Result run(const uint8_t *data, std::size_t size);
+
+  NES &machine() { return *nes; }
+  uint64_t executions() const { return runs; }
+
+private:
+  std::shared_ptr<NES> nes;
+  Options options;
+  std::vector<uint8_t> snapshot;
+  uint64_t runs{};
+};
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <optional>
+#include <queue>
+#include <thread>
+
+#include "InputSearch.h"
+#include "TranspositionTable.h"
+
+namespace {
+
+unsigned workerCount(unsigned requested) {
+  return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+InputSearch::InputSearch(MachineFactory factory, Options options)
+    : options(std::move(options)), pool(workerCount(this->options.threads)) {
+  for (unsigned i = 0; i < pool.size(); i++) {
+    machines.push_back(factory());
+    machines.back()->setFrameOptions(NES::FrameOptions{0, this->options.action_repeat, false});
+  }
+}
+
+InputSearch::Result InputSearch::run(NES &start, const Objective &objective, const Goal &goal) {
+  Result result;
+  TranspositionTable table(options.table_capacity);
+  std::size_t duplicates = 0;
+
+  std::vector<Node> nodes;
+  const uint8_t *start_ram = start.getBus().getRAM();
+  nodes.push_back(Node{PagedState{}, 0, 0, 0, objective(start_ram), goal && goal(start_ram)});
+  nodes[0].state.capture(start);
+  table.insert(start.fingerprint(), TranspositionTable::digest(start), 0);
+  std::size_t best = 0;
+
+  // Step every parent with every input, on the pool. The children are
+  // checked against the table afterwards, in order, so the same child is
+  // kept whatever the number of workers. Returns the indices of the
+  // children that were not pruned, in expansion order.
+  struct Child {
+    Node node;
+    uint64_t fingerprint;
+    uint32_t digest;
+  };
+  auto expand = [&](const std::vector<std::size_t> &parents) {
+    std::size_t inputs = options.inputs.size();
+    std::vector<std::optional<Child>> children(parents.size() * inputs);
+    pool.parallelFor(children.size(), [&](std::size_t i, unsigned worker) {
+      NES &nes = *machines[worker];
+      std::size_t parent = parents[i / inputs];
+      uint8_t input = options.inputs[i % inputs];
+      uint32_t depth = nodes[parent].depth + 1;
+
+      PagedState state = nodes[parent].state.fork();
+      state.restore(nes);
+      nes.step(input);
+      state.capture(nes);
+      const uint8_t *ram = nes.getBus().getRAM();
+      children[i] = Child{Node{std::move(state), parent, input, depth, objective(ram), goal && goal(ram)},
+                          nes.fingerprint(), TranspositionTable::digest(nes)};
+    });
+    result.evaluations += children.size();
+
+    for (std::size_t parent : parents) {
+      nodes[parent].state = PagedState{};
+    }
+    std::vector<std::size_t> added;
+    for (std::optional<Child> &child : children) {
+      if (!table.insert(child->fingerprint, child->digest, child->node.depth)) {
+        duplicates++;
+        continue;
+      }
+      added.push_back(nodes.size());
+      nodes.push_back(std::move(child->node));
+    }
+    return added;
+  };
+
+  // Best of the new nodes, goals first. Returns whether a goal was reached.
+  auto adopt = [&](const std::vector<std::size_t> &added) {
+    bool reached = false;
+    for (std::size_t index : added) {
+      const Node &node = nodes[index];
+      if (node.goal && (!reached || node.score > nodes[best].score)) {
+        best = index;
+        reached = true;
+      } else if (!reached && node.score > nodes[best].score) {
+        best = index;
+      }
+    }
+    return reached;
+  };
+
+  // Higher score first, then the earliest node
+  auto before = [&](std::size_t a, std::size_t b) {
+    return nodes[a].score > nodes[b].score || (nodes[a].score == nodes[b].score && a < b);
+  };
+
+  bool reached = nodes[0].goal;
+  if (options.strategy == Strategy::Beam) {
+    std::vector<std::size_t> frontier{0};
+    for (unsigned depth = 0; !reached && depth < options.max_depth && !frontier.empty(); depth++) {
+      frontier = expand(frontier);
+      reached = adopt(frontier);
+      std::stable_sort(frontier.begin(), frontier.end(), before);
+      for (std::size_t i = options.beam_width; i < frontier.size(); i++) {
+        nodes[frontier[i]].state = PagedState{};
+      }
+      frontier.resize(std::min<std::size_t>(frontier.size(), options.beam_width));
+    }
+  } else {
+    auto worse = [&](std::size_t a, std::size_t b) { return before(b, a); };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(worse)> open(worse);
+    open.push(0);
+    while (!reached && !open.empty() && result.evaluations < options.max_evaluations) {
+      std::vector<std::size_t> batch;
+      while (batch.size() < std::max(options.batch, 1u) && !open.empty()) {
+        std::size_t node = open.top();
+        open.pop();
+        if (nodes[node].depth < options.max_depth) {
+          batch.push_back(node);
+        } else {
+          nodes[node].state = PagedState{};
+        }
+      }
+      if (batch.empty()) {
+        continue;
+      }
+      std::vector<std::size_t> added = expand(batch);
+      reached = adopt(added);
+      for (std::size_t index : added) {
+        open.push(index);
+      }
+    }
+  }
+
+  for (std::size_t node = best; node != 0; node = nodes[node].parent) {
+    result.inputs.push_back(nodes[node].input);
+  }
+  std::reverse(result.inputs.begin(), result.inputs.end());
+  result.score = nodes[best].score;
+  result.goal = nodes[best].goal;
+  result.duplicates = duplicates;
+  return result;
+}
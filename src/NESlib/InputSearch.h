@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "NES.h"
+#include "PagedState.h"
+#include "WorkPool.h"
+
+/**
+ Search for controller input sequences maximizing a RAM objective, for
+ tool-assisted runs ("reach this RAM condition in the fewest frames").
+
+ Nodes are machine states one step apart, a step holding one candidate
+ input for FrameOptions::action_repeat frames. Children fork their parent
+ PagedState, so a node only owns the pages its step changed. States
+ already reached at the same depth or earlier, by another input sequence,
+ are pruned through a TranspositionTable.
+
+ Strategies:
+  - Beam: expand every node of a depth, keep the beam_width best children.
+    The first depth reaching the goal gives the result, so the goal is
+    reached in the fewest steps the beam could find.
+  - BestFirst: repeatedly expand the best scoring open nodes, batch nodes
+    at a time, until the goal or the evaluation budget is reached.
+
+ Each worker thread steps its own machine, built by the factory: every
+ machine must run the same cartridge as the starting one. Children are
+ pruned in expansion order once stepped, so the result does not depend on
+ the number of workers.
+ */
+class InputSearch {
+public:
+  using MachineFactory = std::function<std::shared_ptr<NES>()>;
+  // Score of a state from its internal RAM ($0000 - $07FF), higher is better.
+  // The objective and the goal are called concurrently from the worker
+  // threads, one call per stepped child: they must be thread-safe.
+  using Objective = std::function<double(const uint8_t *ram)>;
+  using Goal = std::function<bool(const uint8_t *ram)>;
+
+  enum class Strategy { Beam, BestFirst };
+
+  struct Options {
+    Strategy strategy = Strategy::Beam;
+    // Controller 1 states tried at each step, see Controller::Button
+    std::vector<uint8_t> inputs{0, Controller::A, Controller::B, Controller::LEFT,
+                                Controller::RIGHT, Controller::UP, Controller::DOWN};
+    unsigned action_repeat = 1;
+    unsigned max_depth = 60;
+    unsigned beam_width = 64;
+    // BestFirst: nodes expanded per round, and child evaluations budget
+    unsigned batch = 16;
+    std::size_t max_evaluations = 100000;
+    // 0 for one worker per hardware thread
+    unsigned threads = 0;
+    std::size_t table_capacity = 1 << 20;
+  };
+
+  struct Result {
+    std::vector<uint8_t> inputs; // Steps from the start to the best state
+    double score = 0;
+    bool goal = false;
+    std::size_t evaluations = 0; // Steps simulated
+    std::size_t duplicates = 0;  // Children pruned by the transposition table
+  };
+
+  InputSearch(MachineFactory factory, Options options);
+
+  // Search from the current state of start, which is left untouched.
+  // Exceptions thrown by the objective or goal are rethrown.
+  Result run(NES &start, const Objective &objective, const Goal &goal = {});
+
+private:
+  struct Node {
+    PagedState state; // Released once expanded
+    std::size_t parent;
+    uint8_t input;
+    uint32_t depth;
+    double score;
+    bool goal;
+  };
+
+  Options options;
+  WorkPool pool;
+  std::vector<std::shared_ptr<NES>> machines; // One per worker
+};
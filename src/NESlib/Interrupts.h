@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Serializer.h"
+
+/**
+ 6502 interrupt and halt input lines.
+
+ NMI is edge triggered: an assertion is latched until the CPU services it.
+ IRQ is level triggered and wired-OR between sources (APU frame counter,
+ DMC, mappers...): it stays asserted while any source holds it low.
+
+ DMA units pull RDY to halt the CPU between instructions.
+
+ All lines are folded into a single byte so the CPU only tests one value
+ per instruction when nothing is pending.
+ */
+class InterruptLines {
+public:
+  enum Source : uint8_t {
+    NMI = 1 << 0,
+    IRQ_APU_FRAME = 1 << 1,
+    IRQ_DMC = 1 << 2,
+    IRQ_MAPPER = 1 << 3,
+    IRQ_EXTERNAL = 1 << 4,
+    DMA_HALT = 1 << 7,
+  };
+  static constexpr uint8_t IRQ_MASK =
+      IRQ_APU_FRAME | IRQ_DMC | IRQ_MAPPER | IRQ_EXTERNAL;
+
+  void triggerNMI() { pending |= NMI; }
+  void acknowledgeNMI() { pending &= ~NMI; }
+
+  void setIRQ(Source source, bool asserted) {
+    if (asserted) {
+      pending |= source & IRQ_MASK;
+    } else {
+      pending &= ~(source & IRQ_MASK);
+    }
+  }
+
+  void requestHalt() { pending |= DMA_HALT; }
+  void releaseHalt() { pending &= ~DMA_HALT; }
+
+  uint8_t state() const { return pending; }
+  bool nmi() const { return pending & NMI; }
+  bool irq() const { return pending & IRQ_MASK; }
+  bool halt() const { return pending & DMA_HALT; }
+
+  void clear() { pending = 0; }
+
+  void serialize(Serializer &s) { s.value(pending); }
+
+private:
+  uint8_t pending{};
+};
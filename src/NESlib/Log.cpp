@@ -0,0 +1,209 @@
+#include <array>
+#include <cstdarg>
+#include <mutex>
+#include <thread>
+
+#include "Log.h"
+
+namespace {
+
+struct Record {
+  int64_t timestamp; // Microseconds since the logger started
+  uint8_t level;
+  LogCategory category;
+  char text[118];
+};
+
+constexpr const char *level_names[] = {"off", "error", "warn", "info", "debug", "trace"};
+constexpr const char *category_names[] = {"cpu", "bus", "ppu", "apu", "mapper", "cartridge"};
+
+/**
+ Bounded multi-producer queue (D. Vyukov's design), each slot carries a
+ sequence number telling whether it is free or holds a record.
+ */
+class RecordQueue {
+public:
+  static constexpr std::size_t capacity = 1024;
+
+  RecordQueue() {
+    for (std::size_t i = 0; i < capacity; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(const Record &record) {
+    std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &slots[position % capacity];
+      std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+      if (diff == 0) {
+        if (enqueue_position.compare_exchange_weak(position, position + 1,
+                                                   std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Full
+      } else {
+        position = enqueue_position.load(std::memory_order_relaxed);
+      }
+    }
+    slot->record = record;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Single consumer
+  bool pop(Record &record) {
+    Slot &slot = slots[dequeue_position % capacity];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1) {
+      return false;
+    }
+    record = slot.record;
+    slot.sequence.store(dequeue_position + capacity, std::memory_order_release);
+    dequeue_position++;
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    Record record;
+  };
+  std::array<Slot, capacity> slots;
+  alignas(64) std::atomic<std::size_t> enqueue_position{0};
+  alignas(64) std::size_t dequeue_position{0};
+};
+
+int64_t elapsedMicroseconds() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+class Logger {
+public:
+  ~Logger() {
+    if (drainer.joinable()) {
+      stopping.store(true, std::memory_order_release);
+      drainer.join();
+    }
+  }
+
+  void push(const Record &record) {
+    std::call_once(started, [this] { drainer = std::thread([this] { drain(); }); });
+    if (!queue.push(record)) {
+      dropped_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void flush() {
+    uint64_t target = pushed();
+    while (written.load(std::memory_order_acquire) < target && drainer.joinable()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  uint64_t pushed() const {
+    return attempted.load(std::memory_order_relaxed) - dropped_count.load(std::memory_order_relaxed);
+  }
+
+  std::atomic<uint32_t> enabled_categories{~0u};
+  std::atomic<std::FILE *> sink{stderr};
+  std::atomic<uint64_t> dropped_count{0};
+  std::atomic<uint64_t> attempted{0};
+
+private:
+  void drain() {
+    Record record;
+    while (true) {
+      bool idle = true;
+      while (queue.pop(record)) {
+        idle = false;
+        std::fprintf(sink.load(std::memory_order_relaxed), "[%10.6f] %-5s %-9s %s\n",
+                     record.timestamp / 1e6, level_names[record.level],
+                     category_names[static_cast<int>(record.category)], record.text);
+        written.fetch_add(1, std::memory_order_release);
+      }
+      if (idle) {
+        std::fflush(sink.load(std::memory_order_relaxed));
+        if (stopping.load(std::memory_order_acquire)) {
+          return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+    }
+  }
+
+  RecordQueue queue;
+  std::once_flag started;
+  std::thread drainer;
+  std::atomic<bool> stopping{false};
+  std::atomic<uint64_t> written{0};
+};
+
+Logger &logger() {
+  static Logger instance;
+  return instance;
+}
+
+} // namespace
+
+namespace Log {
+
+void setEnabled(LogCategory category, bool enabled) {
+  uint32_t bit = 1u << static_cast<int>(category);
+  if (enabled) {
+    logger().enabled_categories.fetch_or(bit, std::memory_order_relaxed);
+  } else {
+    logger().enabled_categories.fetch_and(~bit, std::memory_order_relaxed);
+  }
+}
+
+bool enabled(LogCategory category) {
+  return logger().enabled_categories.load(std::memory_order_relaxed) &
+         (1u << static_cast<int>(category));
+}
+
+void setSink(std::FILE *sink) { logger().sink.store(sink, std::memory_order_relaxed); }
+
+void flush() { logger().flush(); }
+
+uint64_t dropped() { return logger().dropped_count.load(std::memory_order_relaxed); }
+
+void write(int level, LogCategory category, const char *format, ...) {
+  Record record{elapsedMicroseconds(), static_cast<uint8_t>(level), category, {}};
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(record.text, sizeof(record.text), format, args);
+  va_end(args);
+
+  logger().attempted.fetch_add(1, std::memory_order_relaxed);
+  logger().push(record);
+}
+
+bool RateLimiter::allow() {
+  int64_t now = elapsedMicroseconds();
+  int64_t last = last_refill.load(std::memory_order_relaxed);
+  if (now - last >= 1000000 / perSecond &&
+      last_refill.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+    uint32_t refill = static_cast<uint32_t>((now - last) * perSecond / 1000000);
+    uint32_t current = tokens.load(std::memory_order_relaxed);
+    uint32_t updated;
+    do {
+      updated = current + refill > burst ? burst : current + refill;
+    } while (!tokens.compare_exchange_weak(current, updated, std::memory_order_relaxed));
+  }
+
+  uint32_t current = tokens.load(std::memory_order_relaxed);
+  while (current > 0) {
+    if (tokens.compare_exchange_weak(current, current - 1, std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace Log
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ Structured logging.
+
+ Messages below NES_LOG_LEVEL are removed at compile time, so trace and
+ debug statements in hot paths (bus accesses, mapper writes...) cost
+ nothing in regular builds. The remaining ones are filtered per category
+ at runtime, rate limited per call site, formatted into a fixed-size
+ record and pushed to a lock-free queue drained by a background thread.
+ When the queue is full, messages are dropped and counted rather than
+ blocking the emulation.
+ */
+
+#define NES_LOG_LEVEL_OFF 0
+#define NES_LOG_LEVEL_ERROR 1
+#define NES_LOG_LEVEL_WARN 2
+#define NES_LOG_LEVEL_INFO 3
+#define NES_LOG_LEVEL_DEBUG 4
+#define NES_LOG_LEVEL_TRACE 5
+
+#ifndef NES_LOG_LEVEL
+#define NES_LOG_LEVEL NES_LOG_LEVEL_INFO
+#endif
+
+enum class LogCategory : uint8_t { CPU, BUS, PPU, APU, MAPPER, CARTRIDGE, COUNT };
+
+namespace Log {
+
+void setEnabled(LogCategory category, bool enabled);
+bool enabled(LogCategory category);
+
+// Destination of the drained messages, stderr by default
+void setSink(std::FILE *sink);
+
+// Block until every queued message has been written
+void flush();
+uint64_t dropped();
+
+void write(int level, LogCategory category, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ Token bucket shared by all executions of one log statement: bursts of
+ up to `burst` messages, refilled at `perSecond` messages per second.
+ */
+class RateLimiter {
+public:
+  static constexpr uint32_t burst = 16;
+  static constexpr uint32_t perSecond = 16;
+
+  bool allow();
+
+private:
+  std::atomic<uint32_t> tokens{burst};
+  std::atomic<int64_t> last_refill{0};
+};
+
+} // namespace Log
+
+#define NES_LOG(level, category, ...)                                         \
+  do {                                                                        \
+    if constexpr ((level) <= NES_LOG_LEVEL) {                                 \
+      if (Log::enabled(category)) {                                           \
+        static Log::RateLimiter nes_log_limiter_;                             \
+        if (nes_log_limiter_.allow()) {                                       \
+          Log::write((level), (category), __VA_ARGS__);                       \
+        }                                                                     \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
+
+#define NES_LOG_ERROR(category, ...) NES_LOG(NES_LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define NES_LOG_WARN(category, ...) NES_LOG(NES_LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define NES_LOG_INFO(category, ...) NES_LOG(NES_LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define NES_LOG_DEBUG(category, ...) NES_LOG(NES_LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#define NES_LOG_TRACE(category, ...) NES_LOG(NES_LOG_LEVEL_TRACE, category, __VA_ARGS__)
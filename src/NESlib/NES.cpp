@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <utility>
+
+#include "FileLoader.h"
+#include "NES.h"
+#include "mappers/MapperFactory.h"
+
+NES::NES(std::unique_ptr<Mapper> mapper, std::unique_ptr<Cartridge> cartridge)
+    : cartridge(std::move(cartridge)), mapper(std::move(mapper)) {
+  bus = std::make_unique<Bus>(this->mapper.get());
+  cpu = std::make_unique<CPU_6502>(bus.get());
+
+  scheduler.setHandler(EventType::PPU, [this](uint64_t) {
+    PPU &ppu = bus->getPPU();
+    ppu.advance();
+    scheduler.schedule(EventType::PPU, ppu.nextEvent());
+  });
+  scheduler.schedule(EventType::PPU, bus->getPPU().nextEvent());
+}
+
+std::unique_ptr<NES> NES::fromFile(const std::string &filename) {
+  auto cartridge = std::make_unique<Cartridge>(filename);
+  auto mapper = MapperFactory::create(cartridge.get());
+  return std::make_unique<NES>(std::move(mapper), std::move(cartridge));
+}
+
+std::unique_ptr<NES> NES::fromImage(std::span<const uint8_t> image) {
+  auto cartridge = std::make_unique<Cartridge>(image);
+  auto mapper = MapperFactory::create(cartridge.get());
+  return std::make_unique<NES>(std::move(mapper), std::move(cartridge));
+}
+
+std::vector<std::unique_ptr<NES>> NES::fromFiles(const std::vector<std::string> &roms,
+                                                 const std::vector<std::string> &states) {
+  constexpr std::size_t NONE = ~std::size_t{0};
+  FileLoader loader(static_cast<unsigned>(std::min<std::size_t>(roms.size() + states.size(), 256)));
+  std::vector<std::size_t> rom_tickets;
+  std::vector<std::size_t> state_tickets;
+  for (std::size_t i = 0; i < roms.size(); i++) {
+    rom_tickets.push_back(loader.submit(roms[i]));
+    bool has_state = i < states.size() && !states[i].empty();
+    state_tickets.push_back(has_state ? loader.submit(states[i]) : NONE);
+  }
+  loader.flush();
+
+  std::vector<std::unique_ptr<NES>> machines;
+  for (std::size_t i = 0; i < roms.size(); i++) {
+    auto cartridge = std::make_unique<Cartridge>(loader.wait(rom_tickets[i]), roms[i]);
+    auto mapper = MapperFactory::create(cartridge.get());
+    auto nes = std::make_unique<NES>(std::move(mapper), std::move(cartridge));
+    if (state_tickets[i] != NONE) {
+      nes->loadState(loader.wait(state_tickets[i]));
+    }
+    machines.push_back(std::move(nes));
+  }
+  return machines;
+}
+
+void NES::reset() { cpu->reset(); }
+
+void NES::runUntil(uint64_t masterCycle) {
+  while (masterClock() < masterCycle) {
+    uint64_t deadline = std::min(masterCycle, scheduler.nextDeadline());
+    // Round up so the CPU reaches the deadline, instructions are atomic
+    cpu->run((deadline + Scheduler::CPU_DIVIDER - 1) / Scheduler::CPU_DIVIDER);
+    scheduler.dispatch(masterClock());
+  }
+}
+
+CPU_6502::Stop NES::runUntil(uint64_t masterCycle, const CPU_6502::Predicate &predicate) {
+  while (masterClock() < masterCycle) {
+    uint64_t deadline = std::min(masterCycle, scheduler.nextDeadline());
+    auto stop = cpu->runUntil(
+        (deadline + Scheduler::CPU_DIVIDER - 1) / Scheduler::CPU_DIVIDER, predicate);
+    scheduler.dispatch(masterClock());
+    if (stop.reason != CPU_6502::StopReason::Limit) {
+      return stop;
+    }
+  }
+  return CPU_6502::Stop{CPU_6502::StopReason::Limit, cpu->dumpRegisters().PC, 0};
+}
+
+void NES::saveState(std::vector<uint8_t> &state) {
+  Serializer s = Serializer::saver(state);
+  serialize(s);
+  synced_state = &state;
+}
+
+void NES::loadState(const std::vector<uint8_t> &state) {
+  Serializer s = Serializer::loader(state);
+  serialize(s);
+  s.finish();
+  synced_state = &state;
+}
+
+void NES::resetState(const std::vector<uint8_t> &state) {
+  if (synced_state != &state) {
+    loadState(state);
+    return;
+  }
+  Serializer s = Serializer::resetter(state);
+  serialize(s);
+  s.finish();
+}
+
+void NES::updateState(std::vector<uint8_t> &state, std::vector<StateRange> *changed) {
+  if (synced_state != &state) {
+    saveState(state);
+    if (changed) {
+      changed->push_back(StateRange{0, state.size()});
+    }
+    return;
+  }
+  Serializer s = Serializer::updater(state, changed);
+  serialize(s);
+  s.finish();
+}
+
+void NES::serialize(Serializer &s) {
+  bus->serialize(s);
+  cpu->serialize(s);
+  scheduler.serialize(s);
+  s.value(frames_run);
+}
+
+uint64_t NES::stateHash() {
+  updateState(hash_buffer);
+  return hash64(hash_buffer.data(), hash_buffer.size());
+}
+
+uint64_t NES::fingerprint() {
+  uint64_t words[] = {
+      bus->fingerprint(),
+      cpu->fingerprint(),
+      scheduler.deadline(EventType::PPU) - masterClock(),
+  };
+  return hash64(words, sizeof(words));
+}
+
+bool NES::runFrame() {
+  bool render = frame_options.render &&
+                frames_run++ % (frame_options.frameskip + 1) == frame_options.frameskip;
+  PPU &ppu = bus->getPPU();
+  ppu.setRenderSkip(!render);
+
+  uint64_t frame = ppu.frame();
+  while (ppu.frame() == frame) {
+    // Always make progress, even if the CPU already went past the event
+    runUntil(std::max(masterClock() + 1, scheduler.deadline(EventType::PPU)));
+  }
+  mapper->syncSave();
+  if (hash_stream) {
+    hash_stream->write(FrameHash{ppu.frame(), stateHash()});
+  }
+  return render;
+}
+
+bool NES::step(uint8_t buttons) {
+  bus->controller(0).setButtons(buttons);
+  bool rendered = false;
+  for (unsigned i = 0; i < std::max(frame_options.action_repeat, 1u); i++) {
+    rendered = runFrame();
+  }
+  return rendered;
+}
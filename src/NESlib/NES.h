@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Bus.h"
+#include "CPU.h"
+#include "Cartridge.h"
+#include "Scheduler.h"
+#include "StateHash.h"
+#include "mappers/Mapper.h"
+
+/**
+ A complete console: cartridge, mapper, bus, CPU and the master clock
+ scheduler driving them.
+
+ Instead of stepping every component each cycle, the CPU runs freely up to
+ the earliest scheduled event, then the due events are dispatched.
+
+ Frames end when vblank starts. Frame options decide which frames are
+ rendered: skipped frames run the PPU in render skip mode, which keeps
+ everything the CPU can observe, see PPU.h.
+ */
+class NES {
+public:
+  // NTSC frame: 341 dots * 262 scanlines, 4 master cycles per dot
+  static constexpr uint64_t MASTER_CYCLES_PER_FRAME = 341 * 262 * Scheduler::PPU_DIVIDER;
+
+  struct FrameOptions {
+    // Frames run without pixel output between two rendered ones
+    unsigned frameskip = 0;
+    // Frames each input given to step() is held for
+    unsigned action_repeat = 1;
+    // When false no frame is ever rendered
+    bool render = true;
+  };
+
+  explicit NES(std::unique_ptr<Mapper> mapper,
+               std::unique_ptr<Cartridge> cartridge = nullptr);
+  NES(NES &nes) = delete;
+  NES &operator=(const NES &) = delete;
+
+  // Load a ROM image and pick its mapper, throws CartridgeError
+  static std::unique_ptr<NES> fromFile(const std::string &filename);
+  // Same from an image in memory, for fixtures and fuzzers
+  static std::unique_ptr<NES> fromImage(std::span<const uint8_t> image);
+  // One machine per ROM, for batch starts. states[i], when given and not
+  // empty, is a saveState file loaded into machine i. Every file is read
+  // asynchronously up front (see FileLoader), so machines are built while
+  // the later files are still being read. Like fromFile, machines without
+  // a state are not reset. Throws CartridgeError or std::runtime_error.
+  static std::vector<std::unique_ptr<NES>> fromFiles(const std::vector<std::string> &roms,
+                                                     const std::vector<std::string> &states = {});
+
+  void reset();
+
+  // Keep battery backed cartridge RAM in the save file at path, see
+  // Mapper::attachSaveFile. The file is written back at frame boundaries.
+  // False when the cartridge has no battery. Throws std::runtime_error.
+  bool attachSaveFile(const std::string &path) { return mapper->attachSaveFile(path); }
+
+  // Run until the master clock reaches the given timestamp
+  void runUntil(uint64_t masterCycle);
+  // Same, but stopping early on breakpoints, watchpoints or predicate,
+  // see CPU_6502::runUntil. Returns why execution stopped.
+  CPU_6502::Stop runUntil(uint64_t masterCycle, const CPU_6502::Predicate &predicate);
+  // Run up to the next vblank, returns whether the frame was rendered
+  bool runFrame();
+  // Hold buttons on controller 1 for action_repeat frames, returns
+  // whether the last of them was rendered
+  bool step(uint8_t buttons);
+
+  // Whole machine state, see Serializer. Internal RAM is at offset 0.
+  // loadState throws std::runtime_error on a state of another machine.
+  void saveState(std::vector<uint8_t> &state);
+  void loadState(const std::vector<uint8_t> &state);
+  // Bring state up to date, only copying memory blocks written since it
+  // was last saved, loaded or updated, and not modified since. Falls back
+  // to saveState when another buffer was synced in between. Appends the ranges that changed, in
+  // increasing order, to changed when given.
+  void updateState(std::vector<uint8_t> &state, std::vector<StateRange> *changed = nullptr);
+  // Same as loadState, but when state is the buffer last saved, loaded,
+  // updated or reset to, and was not modified since, only the memory
+  // blocks written since then are copied back. Snapshot-reset loops (see
+  // FuzzHarness) call it with the same buffer over and over.
+  void resetState(const std::vector<uint8_t> &state);
+
+  // hash64 of the machine state
+  uint64_t stateHash();
+  // Hash of what the machine will do next, in O(1): memories keep Zobrist
+  // hashes up to date on every write (see StateHash.h), registers are
+  // hashed on demand. Unlike stateHash, absolute time (cycle and frame
+  // counts) is left out, so the same situation reached on two different
+  // frames gets the same fingerprint; the CPU position relative to the
+  // next PPU event is kept.
+  uint64_t fingerprint();
+  // Record the state hash after every frame, nullptr stops recording
+  void setHashStream(HashStreamWriter *stream) { hash_stream = stream; }
+
+  void setFrameOptions(const FrameOptions &options) { frame_options = options; }
+  const FrameOptions &getFrameOptions() const { return frame_options; }
+
+  uint64_t masterClock() const {
+    return cpu->getCycles() * Scheduler::CPU_DIVIDER;
+  }
+
+  Bus &getBus() { return *bus; }
+  CPU_6502 &getCPU() { return *cpu; }
+  Scheduler &getScheduler() { return scheduler; }
+  Mapper &getMapper() { return *mapper; }
+  Cartridge *getCartridge() { return cartridge.get(); }
+
+private:
+  std::unique_ptr<Cartridge> cartridge;
+  std::unique_ptr<Mapper> mapper;
+  std::unique_ptr<Bus> bus;
+  std::unique_ptr<CPU_6502> cpu;
+  Scheduler scheduler;
+  FrameOptions frame_options;
+  uint64_t frames_run{};
+  HashStreamWriter *hash_stream{};
+  std::vector<uint8_t> hash_buffer;
+  // Buffer matching the machine at the last dirty bitmap clear
+  const std::vector<uint8_t> *synced_state{};
+
+  void serialize(Serializer &s);
+};
@@ -0,0 +1,432 @@
+#include <cstring>
+
+#include "PPU.h"
+#include "Scheduler.h"
+#include "StateHash.h"
+
+PPU::PPU(Mapper *mapper, InterruptLines *interrupts) : mapper(mapper), interrupts(interrupts) {
+  memory_hash = zobristHash(Zobrist::NAMETABLES, nametables.data(), nametables.size()) ^
+                zobristHash(Zobrist::PALETTE, palette.data(), palette.size()) ^
+                zobristHash(Zobrist::OAM, oam.data(), oam.size());
+}
+
+uint8_t PPU::readRegister(uint16_t address) {
+  switch (address & 0x7) {
+  case 2: { // PPUSTATUS, the low bits read back the bus latch
+    uint8_t value = (status & 0xE0) | (open_bus & 0x1F);
+    status &= 0x7F; // Reading clears vblank
+    write_toggle = false;
+    return value;
+  }
+  case 4: // OAMDATA
+    return oam[oam_address];
+  case 7: { // PPUDATA, reads below the palette go through a buffer
+    uint16_t vram_address = v & 0x3FFF;
+    uint8_t value;
+    if (vram_address >= 0x3F00) {
+      value = (readVRAM(vram_address) & 0x3F) | (open_bus & 0xC0);
+      read_buffer = readVRAM(vram_address - 0x1000);
+    } else {
+      value = read_buffer;
+      read_buffer = readVRAM(vram_address);
+    }
+    setAddress(v + (ctrl & 0x04 ? 32 : 1));
+    return value;
+  }
+  default: // Write-only registers
+    return open_bus;
+  }
+}
+
+void PPU::writeRegister(uint16_t address, uint8_t value) {
+  open_bus = value;
+  switch (address & 0x7) {
+  case 0:
+    // Enabling NMI during vblank fires it immediately
+    if (!(ctrl & 0x80) && (value & 0x80) && (status & 0x80)) {
+      interrupts->triggerNMI();
+    }
+    ctrl = value;
+    t = (t & ~0x0C00) | ((value & 0x03) << 10);
+    break;
+  case 1:
+    mask = value;
+    break;
+  case 3:
+    oam_address = value;
+    break;
+  case 4:
+    memory_hash ^= zobrist(Zobrist::OAM + oam_address, oam[oam_address]) ^
+                   zobrist(Zobrist::OAM + oam_address, value);
+    oam[oam_address++] = value;
+    break;
+  case 5: // PPUSCROLL, X then Y
+    if (!write_toggle) {
+      t = (t & ~0x001F) | (value >> 3);
+      fine_x = value & 0x07;
+    } else {
+      t = (t & ~0x73E0) | ((value & 0x07) << 12) | ((value & 0xF8) << 2);
+    }
+    write_toggle = !write_toggle;
+    break;
+  case 6: // PPUADDR, high then low byte
+    if (!write_toggle) {
+      t = (t & 0x00FF) | ((value & 0x3F) << 8);
+    } else {
+      t = (t & 0xFF00) | value;
+      setAddress(t);
+    }
+    write_toggle = !write_toggle;
+    break;
+  case 7: // PPUDATA
+    writeVRAM(v & 0x3FFF, value);
+    setAddress(v + (ctrl & 0x04 ? 32 : 1));
+    break;
+  }
+}
+
+void PPU::writeOAM(const uint8_t *page) {
+  // The transfer goes through OAMDATA, so it wraps around from OAMADDR
+  std::size_t head = OAM_SIZE - oam_address;
+  memory_hash ^= zobristHash(Zobrist::OAM, oam.data(), OAM_SIZE);
+  std::memcpy(&oam[oam_address], page, head);
+  std::memcpy(&oam[0], page + head, oam_address);
+  memory_hash ^= zobristHash(Zobrist::OAM, oam.data(), OAM_SIZE);
+}
+
+void PPU::setAddress(uint16_t address) {
+  address &= 0x7FFF;
+  // CPU driven VRAM accesses clock MMC3 counters too
+  if (!(v & 0x1000) && (address & 0x1000)) {
+    mapper->ppuA12Rise();
+  }
+  v = address;
+}
+
+uint8_t PPU::readVRAM(uint16_t address) {
+  address &= 0x3FFF;
+  if (address < 0x2000) {
+    return mapper->readCHR(address);
+  } else if (address < 0x3F00) {
+    return nametables[nametableIndex(address)];
+  }
+  return palette[paletteIndex(address)];
+}
+
+void PPU::writeVRAM(uint16_t address, uint8_t value) {
+  address &= 0x3FFF;
+  if (address < 0x2000) {
+    mapper->writeCHR(address, value);
+  } else if (address < 0x3F00) {
+    uint16_t index = nametableIndex(address);
+    memory_hash ^= zobrist(Zobrist::NAMETABLES + index, nametables[index]) ^
+                   zobrist(Zobrist::NAMETABLES + index, value);
+    nametables[index] = value;
+    nametable_dirty.mark(index);
+  } else {
+    uint8_t index = paletteIndex(address);
+    memory_hash ^= zobrist(Zobrist::PALETTE + index, palette[index]) ^
+                   zobrist(Zobrist::PALETTE + index, value & 0x3F);
+    palette[index] = value & 0x3F;
+  }
+}
+
+uint16_t PPU::nametableIndex(uint16_t address) {
+  uint16_t table = (address >> 10) & 0x3;
+  switch (mapper->mirroring()) {
+  case Mirroring::Horizontal:
+    table >>= 1;
+    break;
+  case Mirroring::Vertical:
+    table &= 1;
+    break;
+  case Mirroring::FourScreen:
+    break;
+  }
+  return (table << 10) | (address & 0x03FF);
+}
+
+uint8_t PPU::paletteIndex(uint16_t address) {
+  uint8_t index = address & 0x1F;
+  // Sprite backdrop entries mirror the background ones
+  if ((index & 0x13) == 0x10) {
+    index &= 0x0F;
+  }
+  return index;
+}
+
+void PPU::serialize(Serializer &s) {
+  s.blocks(nametables.data(), nametable_dirty);
+  s.array(palette);
+  s.array(oam);
+  s.value(ctrl);
+  s.value(mask);
+  s.value(status);
+  s.value(oam_address);
+  s.value(open_bus);
+  s.value(read_buffer);
+  s.value(v);
+  s.value(t);
+  s.value(fine_x);
+  s.value(write_toggle);
+  s.value(frame_start);
+  s.value(line);
+  s.value(dot);
+  s.value(odd_frame);
+  s.value(frames);
+  s.value(memory_hash);
+}
+
+uint64_t PPU::fingerprint() const {
+  uint8_t registers[] = {
+      ctrl, mask, status, oam_address, open_bus, read_buffer,
+      static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8),
+      static_cast<uint8_t>(t), static_cast<uint8_t>(t >> 8),
+      fine_x, write_toggle,
+      static_cast<uint8_t>(line), static_cast<uint8_t>(line >> 8),
+      static_cast<uint8_t>(dot), static_cast<uint8_t>(dot >> 8),
+      odd_frame,
+  };
+  return hash64(registers, sizeof(registers), memory_hash);
+}
+
+uint64_t PPU::nextEvent() const {
+  return frame_start +
+         static_cast<uint64_t>(line * DOTS_PER_LINE + dot) * Scheduler::PPU_DIVIDER;
+}
+
+void PPU::advance() {
+  if (line < HEIGHT) {
+    visibleLine();
+    if (++line == HEIGHT) {
+      line = 241;
+      dot = 1;
+    }
+  } else if (line == 241) {
+    startVBlank();
+    line = LINES_PER_FRAME - 1;
+    dot = 1;
+  } else if (dot == 1) {
+    status &= 0x1F; // Vblank, sprite 0 hit and overflow
+    dot = 304;
+  } else {
+    preRenderLine();
+    line = 0;
+    dot = 256;
+  }
+}
+
+void PPU::visibleLine() {
+  if (!renderingEnabled()) {
+    if (!render_skip) {
+      std::memset(&frame_buffer[line * WIDTH], palette[0] & (mask & 0x01 ? 0x30 : 0x3F), WIDTH);
+    }
+    return;
+  }
+
+  evaluateSprites();
+  checkSpriteZero();
+  if (!render_skip) {
+    renderLine();
+  }
+
+  // Dots 257 - 320: sprite fetches
+  oam_address = 0;
+  clockA12();
+  incrementY();
+  copyHorizontal();
+}
+
+void PPU::preRenderLine() {
+  bool rendering = renderingEnabled();
+  if (rendering) {
+    oam_address = 0;
+    clockA12();
+    copyHorizontal();
+    copyVertical();
+  }
+
+  // The idle dot at the end of the pre-render line is skipped on odd frames
+  uint64_t dots = LINES_PER_FRAME * DOTS_PER_LINE;
+  if (odd_frame && rendering) {
+    dots--;
+  }
+  odd_frame = !odd_frame;
+  frame_start += dots * Scheduler::PPU_DIVIDER;
+}
+
+void PPU::startVBlank() {
+  status |= 0x80;
+  frames++;
+  if (ctrl & 0x80) {
+    interrupts->triggerNMI();
+  }
+}
+
+void PPU::clockA12() {
+  // One rise per line when backgrounds and sprites use different pattern
+  // tables, 8x16 sprites pick their table per tile
+  bool background_high = ctrl & 0x10;
+  bool sprites_high = ctrl & 0x08;
+  if (spriteHeight() == 16 || background_high != sprites_high) {
+    mapper->ppuA12Rise();
+  }
+}
+
+void PPU::incrementY() {
+  if ((v & 0x7000) != 0x7000) {
+    v += 0x1000; // Fine Y
+    return;
+  }
+  v &= ~0x7000;
+  uint16_t coarse_y = (v & 0x03E0) >> 5;
+  if (coarse_y == 29) {
+    coarse_y = 0;
+    v ^= 0x0800; // Next vertical nametable
+  } else if (coarse_y == 31) {
+    coarse_y = 0; // Attribute rows wrap without switching nametable
+  } else {
+    coarse_y++;
+  }
+  v = (v & ~0x03E0) | (coarse_y << 5);
+}
+
+PPU::Tile PPU::fetchBackground(unsigned column) {
+  unsigned coarse_x = (v & 0x001F) + column;
+  uint16_t nametable = v & 0x0C00;
+  if (coarse_x >= 32) {
+    coarse_x -= 32;
+    nametable ^= 0x0400;
+  }
+  unsigned coarse_y = (v >> 5) & 0x1F;
+  unsigned fine_y = (v >> 12) & 0x7;
+
+  uint8_t tile = readVRAM(0x2000 | nametable | (coarse_y << 5) | coarse_x);
+  uint8_t attribute = readVRAM(0x23C0 | nametable | ((coarse_y >> 2) << 3) | (coarse_x >> 2));
+  uint8_t shift = ((coarse_y & 0x02) << 1) | (coarse_x & 0x02);
+
+  uint16_t pattern = (ctrl & 0x10 ? 0x1000 : 0) + tile * 16 + fine_y;
+  return Tile{mapper->readCHR(pattern), mapper->readCHR(pattern + 8),
+              static_cast<uint8_t>((attribute >> shift) & 0x03)};
+}
+
+PPU::Tile PPU::fetchSprite(const uint8_t *sprite, int row) {
+  int height = spriteHeight();
+  if (sprite[2] & 0x80) { // Vertical flip
+    row = height - 1 - row;
+  }
+
+  uint8_t tile = sprite[1];
+  uint16_t pattern;
+  if (height == 16) {
+    pattern = (tile & 0x01) * 0x1000 + (tile & 0xFE) * 16;
+    if (row >= 8) {
+      pattern += 16;
+      row -= 8;
+    }
+  } else {
+    pattern = (ctrl & 0x08 ? 0x1000 : 0) + tile * 16;
+  }
+  pattern += row;
+  return Tile{mapper->readCHR(pattern), mapper->readCHR(pattern + 8),
+              static_cast<uint8_t>(sprite[2] & 0x03)};
+}
+
+void PPU::evaluateSprites() {
+  // OAM holds the sprite top minus one
+  int height = spriteHeight();
+  line_sprite_count = 0;
+  sprite_zero_on_line = false;
+  for (std::size_t i = 0; i < OAM_SIZE; i += 4) {
+    int row = line - 1 - oam[i];
+    if (row < 0 || row >= height) {
+      continue;
+    }
+    if (line_sprite_count == 8) {
+      status |= 0x20;
+      break;
+    }
+    line_sprites[line_sprite_count++] = i / 4;
+    sprite_zero_on_line |= i == 0;
+  }
+}
+
+void PPU::checkSpriteZero() {
+  if (!sprite_zero_on_line || (status & 0x40) || (mask & 0x18) != 0x18) {
+    return;
+  }
+
+  // Only sprite 0's 8 pixels are looked at, which is all render skip pays for
+  const uint8_t *sprite = &oam[0];
+  Tile pattern = fetchSprite(sprite, line - 1 - sprite[0]);
+  for (int i = 0; i < 8; i++) {
+    int x = sprite[3] + i;
+    if (x == 255) {
+      break;
+    }
+    if (x < 8 && (mask & 0x06) != 0x06) {
+      continue;
+    }
+    int bit = sprite[2] & 0x40 ? i : 7 - i;
+    if (!(((pattern.low >> bit) | (pattern.high >> bit << 1)) & 0x03)) {
+      continue;
+    }
+    unsigned position = fine_x + x;
+    Tile background = fetchBackground(position >> 3);
+    int background_bit = 7 - (position & 0x7);
+    if (((background.low >> background_bit) | (background.high >> background_bit << 1)) & 0x03) {
+      status |= 0x40;
+      return;
+    }
+  }
+}
+
+void PPU::renderLine() {
+  // 2-bit pixel and palette, shifted by fine X
+  uint8_t background[WIDTH + 8] = {};
+  if (mask & 0x08) {
+    for (unsigned column = 0; column <= 32; column++) {
+      Tile tile = fetchBackground(column);
+      for (int bit = 0; bit < 8; bit++) {
+        uint8_t pixel = ((tile.low >> (7 - bit)) & 0x01) | (((tile.high >> (7 - bit)) & 0x01) << 1);
+        background[column * 8 + bit] = pixel ? (tile.palette << 2) | pixel : 0;
+      }
+    }
+  }
+
+  // Sprite palette entry, bit 7 set when behind the background. Earlier
+  // sprites win, even when they are behind the background.
+  uint8_t sprites[WIDTH] = {};
+  if (mask & 0x10) {
+    for (int i = 0; i < line_sprite_count; i++) {
+      const uint8_t *sprite = &oam[line_sprites[i] * 4];
+      Tile pattern = fetchSprite(sprite, line - 1 - sprite[0]);
+      for (int j = 0; j < 8; j++) {
+        int x = sprite[3] + j;
+        if (x >= WIDTH) {
+          break;
+        }
+        if (sprites[x]) {
+          continue;
+        }
+        int bit = sprite[2] & 0x40 ? j : 7 - j;
+        uint8_t pixel = ((pattern.low >> bit) & 0x01) | (((pattern.high >> bit) & 0x01) << 1);
+        if (pixel) {
+          sprites[x] = 0x10 | (pattern.palette << 2) | pixel | (sprite[2] & 0x20 ? 0x80 : 0);
+        }
+      }
+    }
+  }
+
+  uint8_t greyscale = mask & 0x01 ? 0x30 : 0x3F;
+  uint8_t *out = &frame_buffer[line * WIDTH];
+  for (int x = 0; x < WIDTH; x++) {
+    uint8_t back = x < 8 && !(mask & 0x02) ? 0 : background[x + fine_x];
+    uint8_t front = x < 8 && !(mask & 0x04) ? 0 : sprites[x];
+    uint8_t index = back;
+    if (front && (!back || !(front & 0x80))) {
+      index = front & 0x1F;
+    }
+    out[x] = palette[paletteIndex(index)] & greyscale;
+  }
+}
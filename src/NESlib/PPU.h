@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "DirtyBitmap.h"
+#include "Interrupts.h"
+#include "Serializer.h"
+#include "mappers/Mapper.h"
+
+/**
+ Picture Processing Unit, 2C02.
+ https://www.nesdev.org/wiki/PPU_registers
+
+ CPU-visible registers, mirrored every 8 bytes in $2000 - $3FFF
+ --------------------------
+ $2000      PPUCTRL     write
+ $2001      PPUMASK     write
+ $2002      PPUSTATUS   read
+ $2003      OAMADDR     write
+ $2004      OAMDATA     read/write
+ $2005      PPUSCROLL   write x2
+ $2006      PPUADDR     write x2
+ $2007      PPUDATA     read/write
+
+ Sprite attribute memory (OAM) is also filled by the CPU through OAM DMA,
+ see Bus::writeByte.
+
+ PPU memory map
+ --------------------------
+ $0000 - $1FFF      pattern tables, see Mapper::readCHR
+ $2000 - $2FFF      nametables, mirrored according to Mapper::mirroring
+ $3000 - $3EFF      mirrors $2000 - $2EFF
+ $3F00 - $3F1F      palette RAM
+ $3F20 - $3FFF      mirrors $3F00 - $3F1F
+
+ Timing
+ --------------------------
+ https://www.nesdev.org/wiki/PPU_rendering
+ The PPU is not clocked per dot. advance() runs the work due at
+ nextEvent() and moves on to the next one, the scheduler calls it at:
+  - dot 256 of each visible line, which is rendered as a whole: sprite 0
+    hit and overflow, MMC3 A12 clock, then scrolling
+  - dot 1 of line 241, vblank and NMI
+  - dots 1 and 304 of the pre-render line, flags cleared and scrolling
+    reloaded; odd frames are one dot shorter while rendering
+
+ With render skip on, visible lines keep every CPU-visible effect but
+ skip pixel composition and palette lookups: the frame buffer is left as is.
+ */
+class PPU {
+public:
+  static constexpr std::size_t OAM_SIZE = 0x100;
+  static constexpr int WIDTH = 256;
+  static constexpr int HEIGHT = 240;
+  static constexpr int DOTS_PER_LINE = 341;
+  static constexpr int LINES_PER_FRAME = 262;
+
+  PPU(Mapper *mapper, InterruptLines *interrupts);
+  PPU(PPU &ppu) = delete;
+  PPU &operator=(const PPU &) = delete;
+
+  uint8_t readRegister(uint16_t address);
+  void writeRegister(uint16_t address, uint8_t value);
+
+  // Bulk OAM DMA transfer of a full page, starting at OAMADDR
+  void writeOAM(const uint8_t *page);
+
+  const std::array<uint8_t, OAM_SIZE> &getOAM() const { return oam; }
+
+  // Master clock timestamp of the next PPU work, see advance()
+  uint64_t nextEvent() const;
+  void advance();
+
+  void setRenderSkip(bool skip) { render_skip = skip; }
+  bool renderSkip() const { return render_skip; }
+
+  // Frames completed so far, incremented when vblank starts
+  uint64_t frame() const { return frames; }
+  // Last rendered picture, one NES colour index ($00 - $3F) per pixel
+  const std::array<uint8_t, WIDTH * HEIGHT> &getFrameBuffer() const { return frame_buffer; }
+
+  // Nametable blocks written since the last serialization
+  using NametableDirtyBitmap = DirtyBitmap<0x1000, 64>;
+  NametableDirtyBitmap &dirtyNametables() { return nametable_dirty; }
+
+  // Registers, memories and timing. The frame buffer and render skip mode
+  // are outputs, not state.
+  void serialize(Serializer &s);
+  // Hash of the registers and memories in O(1), leaving out the frame
+  // count, see NES::fingerprint
+  uint64_t fingerprint() const;
+
+private:
+  struct Tile {
+    uint8_t low;
+    uint8_t high;
+    uint8_t palette;
+  };
+
+  uint8_t readVRAM(uint16_t address);
+  void writeVRAM(uint16_t address, uint8_t value);
+  uint16_t nametableIndex(uint16_t address);
+  static uint8_t paletteIndex(uint16_t address);
+  void setAddress(uint16_t address);
+
+  bool renderingEnabled() const { return mask & 0x18; }
+  int spriteHeight() const { return ctrl & 0x20 ? 16 : 8; }
+
+  void visibleLine();
+  void preRenderLine();
+  void startVBlank();
+  void clockA12();
+
+  // Background tile of the current line at screen column 0 - 32
+  Tile fetchBackground(unsigned column);
+  // Pattern row of a sprite, row counted from its top
+  Tile fetchSprite(const uint8_t *sprite, int row);
+  void evaluateSprites();
+  void checkSpriteZero();
+  void renderLine();
+
+  void incrementY();
+  void copyHorizontal() { v = (v & ~0x041F) | (t & 0x041F); }
+  void copyVertical() { v = (v & ~0x7BE0) | (t & 0x7BE0); }
+
+  Mapper *mapper;
+  InterruptLines *interrupts;
+
+  uint8_t ctrl{};
+  uint8_t mask{};
+  uint8_t status{};
+  uint8_t oam_address{};
+  uint8_t open_bus{}; // Last value written to any register
+  uint8_t read_buffer{};
+
+  // Scrolling registers, see https://www.nesdev.org/wiki/PPU_scrolling
+  uint16_t v{};
+  uint16_t t{};
+  uint8_t fine_x{};
+  bool write_toggle{};
+
+  // Position of the next event
+  uint64_t frame_start{};
+  int line{};
+  int dot{256};
+  bool odd_frame{};
+  uint64_t frames{};
+  bool render_skip{};
+
+  // Sprites on the current line, in OAM order
+  std::array<uint8_t, 8> line_sprites{};
+  int line_sprite_count{};
+  bool sprite_zero_on_line{};
+
+  std::array<uint8_t, OAM_SIZE> oam{};
+  std::array<uint8_t, 0x1000> nametables{};
+  NametableDirtyBitmap nametable_dirty;
+  std::array<uint8_t, 0x20> palette{};
+  uint64_t memory_hash{}; // Zobrist hash of the nametables, palette and OAM
+  std::array<uint8_t, WIDTH * HEIGHT> frame_buffer{};
+};
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "NES.h"
+#include "PagedState.h"
+
+namespace {
+
+// Serialization buffer, one per thread so states stay small. It holds the
+// content of the state owner, last restored into or captured from machine.
+struct Scratch {
+  std::vector<uint8_t> state;
+  std::vector<StateRange> changed;
+  uint64_t owner{};
+  const NES *machine{};
+};
+
+Scratch &scratch() {
+  thread_local Scratch buffer;
+  return buffer;
+}
+
+} // namespace
+
+uint64_t PagedState::nextId() {
+  static std::atomic<uint64_t> counter{1};
+  return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+PagedState::PagedState(PagedState &&other) noexcept
+    : pages(std::move(other.pages)), state_size(other.state_size), id(other.id) {
+  other.pages.clear();
+  other.state_size = 0;
+  other.id = nextId();
+}
+
+PagedState &PagedState::operator=(const PagedState &other) {
+  if (this != &other) {
+    pages = other.pages;
+    state_size = other.state_size;
+    id = nextId();
+  }
+  return *this;
+}
+
+PagedState &PagedState::operator=(PagedState &&other) noexcept {
+  if (this != &other) {
+    pages = std::move(other.pages);
+    state_size = other.state_size;
+    id = other.id;
+    other.pages.clear();
+    other.state_size = 0;
+    other.id = nextId();
+  }
+  return *this;
+}
+
+void PagedState::capture(NES &nes) {
+  Scratch &buffer = scratch();
+  buffer.changed.clear();
+  if (buffer.owner == id && buffer.machine == &nes && !pages.empty()) {
+    // Only the blocks written since restore() or the last capture()
+    nes.updateState(buffer.state, &buffer.changed);
+  } else {
+    nes.saveState(buffer.state);
+    buffer.changed.push_back(StateRange{0, buffer.state.size()});
+  }
+  buffer.owner = id;
+  buffer.machine = &nes;
+
+  const std::vector<uint8_t> &state = buffer.state;
+  if (state.size() != state_size) {
+    pages.clear();
+    state_size = state.size();
+    pages.resize((state_size + PAGE_SIZE - 1) / PAGE_SIZE);
+  }
+
+  for (const StateRange &range : buffer.changed) {
+    std::size_t last = (range.offset + range.size - 1) / PAGE_SIZE;
+    for (std::size_t i = range.offset / PAGE_SIZE; i <= last; i++) {
+      const uint8_t *data = &state[i * PAGE_SIZE];
+      std::size_t length = std::min(PAGE_SIZE, state_size - i * PAGE_SIZE);
+      std::shared_ptr<Page> &page = pages[i];
+      if (page && std::memcmp(page->data(), data, length) == 0) {
+        continue;
+      }
+      if (!page || page.use_count() > 1) {
+        // Copy on write, other states keep the old page
+        page = std::make_shared<Page>();
+      }
+      std::memcpy(page->data(), data, length);
+    }
+  }
+}
+
+void PagedState::restore(NES &nes) const {
+  Scratch &buffer = scratch();
+  read(buffer.state);
+  nes.loadState(buffer.state);
+  buffer.owner = id;
+  buffer.machine = &nes;
+}
+
+void PagedState::read(std::vector<uint8_t> &state) const {
+  state.resize(state_size);
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    std::size_t length = std::min(PAGE_SIZE, state_size - i * PAGE_SIZE);
+    std::memcpy(&state[i * PAGE_SIZE], pages[i]->data(), length);
+  }
+}
+
+std::size_t PagedState::ownedPages() const {
+  return std::count_if(pages.begin(), pages.end(),
+                       [](const std::shared_ptr<Page> &page) { return page.use_count() == 1; });
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class NES;
+
+/**
+ Machine state split in reference counted pages, for input searches
+ holding many branches of the same run.
+
+ fork() shares every page with the original. capture() stores a machine
+ into the state and only copies the pages it changed, so a branch costs
+ the pages its frames touched, usually a few hundred bytes of RAM and
+ VRAM, instead of a whole state. Shared pages are never written, so
+ states sharing pages can live on different threads; a single state must
+ not be forked or restored while it is being captured.
+ */
+class PagedState {
+public:
+  static constexpr std::size_t PAGE_SIZE = 256;
+
+  PagedState() = default;
+  // Copies are new states sharing every page, moves keep the identity
+  PagedState(const PagedState &other) : pages(other.pages), state_size(other.state_size) {}
+  PagedState(PagedState &&other) noexcept;
+  PagedState &operator=(const PagedState &other);
+  PagedState &operator=(PagedState &&other) noexcept;
+
+  // Save the machine, reusing the pages it did not change
+  void capture(NES &nes);
+  // Load the machine from this state
+  void restore(NES &nes) const;
+
+  PagedState fork() const { return *this; }
+
+  bool empty() const { return pages.empty(); }
+  std::size_t size() const { return state_size; }
+  std::size_t pageCount() const { return pages.size(); }
+  // Pages not shared with any other state
+  std::size_t ownedPages() const;
+
+  // Whole state, as NES::saveState lays it out
+  void read(std::vector<uint8_t> &state) const;
+
+private:
+  using Page = std::array<uint8_t, PAGE_SIZE>;
+
+  static uint64_t nextId();
+
+  std::vector<std::shared_ptr<Page>> pages;
+  std::size_t state_size{};
+  // Tells whether the thread's serialization buffer holds this state
+  uint64_t id = nextId();
+};
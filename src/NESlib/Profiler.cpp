@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+#include "Profiler.h"
+
+namespace {
+
+struct Hotspot {
+  uint16_t bank;
+  uint16_t pc;
+  Profiler::Counter counter;
+};
+
+std::string formatLine(const char *format, ...) __attribute__((format(printf, 1, 2)));
+std::string formatLine(const char *format, ...) {
+  char line[128];
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  return line;
+}
+
+} // namespace
+
+void Profiler::clear() {
+  banks.clear();
+  current = nullptr;
+  current_bank = -1;
+  retagged.fill(Counter{});
+}
+
+void Profiler::select(uint16_t bank) {
+  if (bank >= banks.size()) {
+    banks.resize(bank + 1);
+  }
+  if (!banks[bank]) {
+    banks[bank] = std::make_unique<Bank>();
+  }
+  current = banks[bank].get();
+  current_bank = bank;
+}
+
+void Profiler::retag(Site &site, uint8_t opcode) {
+  retagged[site.opcode].count += site.count;
+  retagged[site.opcode].cycles += site.cycles;
+  retagged[opcode].count -= site.count;
+  retagged[opcode].cycles -= site.cycles;
+  site.opcode = opcode;
+}
+
+std::array<Profiler::Counter, 256> Profiler::getOpcodes() const {
+  std::array<Counter, 256> opcodes = retagged;
+  for (const auto &bank : banks) {
+    if (!bank) {
+      continue;
+    }
+    for (const Site &site : *bank) {
+      opcodes[site.opcode].count += site.count;
+      opcodes[site.opcode].cycles += site.cycles;
+    }
+  }
+  return opcodes;
+}
+
+Profiler::Counter Profiler::get(uint16_t bank, uint16_t pc) const {
+  if (bank >= banks.size() || !banks[bank]) {
+    return Counter{};
+  }
+  const Site &site = (*banks[bank])[pc];
+  return Counter{site.count, site.cycles};
+}
+
+uint64_t Profiler::totalCycles() const {
+  uint64_t total = 0;
+  for (const auto &bank : banks) {
+    if (!bank) {
+      continue;
+    }
+    for (const Site &site : *bank) {
+      total += site.cycles;
+    }
+  }
+  return total;
+}
+
+void Profiler::report(std::ostream &out, std::size_t top) const {
+  std::vector<Hotspot> sites;
+  for (std::size_t bank = 0; bank < banks.size(); bank++) {
+    if (!banks[bank]) {
+      continue;
+    }
+    for (std::size_t pc = 0; pc < 0x10000; pc++) {
+      const Counter counter = get(bank, pc);
+      if (counter.count != 0) {
+        sites.push_back(Hotspot{static_cast<uint16_t>(bank), static_cast<uint16_t>(pc), counter});
+      }
+    }
+  }
+  auto byCycles = [](const Hotspot &a, const Hotspot &b) { return a.counter.cycles > b.counter.cycles; };
+  std::size_t shown = std::min(top, sites.size());
+  std::partial_sort(sites.begin(), sites.begin() + shown, sites.end(), byCycles);
+
+  std::array<Counter, 256> opcodes = getOpcodes();
+  double total = static_cast<double>(std::max<uint64_t>(totalCycles(), 1));
+  out << formatLine("%-10s %14s %14s %7s\n", "bank:pc", "executions", "cycles", "%");
+  for (std::size_t i = 0; i < shown; i++) {
+    const Hotspot &site = sites[i];
+    out << formatLine("%02X:%04X    %14llu %14llu %6.2f%%\n", site.bank, site.pc,
+                      static_cast<unsigned long long>(site.counter.count),
+                      static_cast<unsigned long long>(site.counter.cycles),
+                      100.0 * site.counter.cycles / total);
+  }
+
+  std::vector<uint8_t> order(256);
+  for (int i = 0; i < 256; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(),
+            [&opcodes](uint8_t a, uint8_t b) { return opcodes[a].cycles > opcodes[b].cycles; });
+
+  out << formatLine("\n%-10s %14s %14s %7s\n", "opcode", "executions", "cycles", "%");
+  for (std::size_t i = 0; i < std::min<std::size_t>(top, 256); i++) {
+    const Counter &counter = opcodes[order[i]];
+    if (counter.count == 0) {
+      break;
+    }
+    out << formatLine("$%02X        %14llu %14llu %6.2f%%\n", order[i],
+                      static_cast<unsigned long long>(counter.count),
+                      static_cast<unsigned long long>(counter.cycles),
+                      100.0 * counter.cycles / total);
+  }
+}
+
+void Profiler::dump(std::ostream &out) const {
+  out << "kind,bank,address,count,cycles\n";
+  std::array<Counter, 256> opcodes = getOpcodes();
+  for (int opcode = 0; opcode < 256; opcode++) {
+    if (opcodes[opcode].count != 0) {
+      out << "opcode,," << opcode << ',' << opcodes[opcode].count << ','
+          << opcodes[opcode].cycles << '\n';
+    }
+  }
+  for (std::size_t bank = 0; bank < banks.size(); bank++) {
+    if (!banks[bank]) {
+      continue;
+    }
+    for (std::size_t pc = 0; pc < 0x10000; pc++) {
+      const Site &counter = (*banks[bank])[pc];
+      if (counter.count != 0) {
+        out << "pc," << bank << ',' << pc << ',' << counter.count << ',' << counter.cycles
+            << '\n';
+      }
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/**
+ Execution histogram of guest code, per opcode and per bank-qualified PC.
+
+ CPU_6502 feeds it one record per instruction when built with NES_PROFILER
+ and a profiler is attached; without NES_PROFILER the hook is compiled out.
+ PCs are keyed by (PRG bank, address) so code running from the same
+ address in different banks is counted separately.
+
+ Only the site counters are updated per instruction. Each site remembers
+ the opcode last executed there, the per-opcode table is summed from the
+ sites on request; code rewritten in RAM moves the counts of its old
+ opcode to a correction table.
+ */
+class Profiler {
+public:
+  struct Counter {
+    uint64_t count{};
+    uint64_t cycles{};
+  };
+
+  void record(uint16_t bank, uint16_t pc, uint8_t opcode, uint32_t cycles) {
+    Site &site = at(bank, pc);
+    if (site.opcode != opcode) [[unlikely]] {
+      retag(site, opcode);
+    }
+    site.count++;
+    site.cycles += cycles;
+  }
+
+  void clear();
+
+  std::array<Counter, 256> getOpcodes() const;
+  Counter get(uint16_t bank, uint16_t pc) const;
+  uint64_t totalCycles() const;
+
+  // Human-readable report: hottest PCs and opcodes, sorted by cycles
+  void report(std::ostream &out, std::size_t top = 20) const;
+  // CSV dump of every non-zero counter: kind,bank,address,count,cycles
+  void dump(std::ostream &out) const;
+
+private:
+  struct Site {
+    uint64_t count{};
+    uint64_t cycles{};
+    uint8_t opcode{};
+  };
+  using Bank = std::array<Site, 0x10000>;
+
+  Site &at(uint16_t bank, uint16_t pc) {
+    if (bank != current_bank) [[unlikely]] {
+      select(bank);
+    }
+    return (*current)[pc];
+  }
+  void select(uint16_t bank);
+  void retag(Site &site, uint8_t opcode);
+
+  std::vector<std::unique_ptr<Bank>> banks;
+  Bank *current{};
+  int current_bank = -1;
+  // Added to the sums of the sites, modulo 2^64: a retagged site's counts
+  // so far go to its old opcode and are taken back from the new one
+  std::array<Counter, 256> retagged{};
+};
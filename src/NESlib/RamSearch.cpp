@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "NES.h"
+#include "RamSearch.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NES_RAM_SEARCH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool holds(uint8_t a, uint8_t b, RamSearch::Compare op) {
+  switch (op) {
+  case RamSearch::Compare::Equal:
+    return a == b;
+  case RamSearch::Compare::NotEqual:
+    return a != b;
+  case RamSearch::Compare::Less:
+    return a < b;
+  case RamSearch::Compare::Greater:
+    return a > b;
+  case RamSearch::Compare::LessEqual:
+    return a <= b;
+  case RamSearch::Compare::GreaterEqual:
+    return a >= b;
+  }
+  return false;
+}
+
+// mask[i] is cleared where a[i] op b[i] does not hold, from index start
+void filterScalar(const uint8_t *a, const uint8_t *b, uint8_t *mask, std::size_t start,
+                  std::size_t size, RamSearch::Compare op) {
+  for (std::size_t i = start; i < size; i++) {
+    mask[i] &= holds(a[i], b[i], op) ? 0xFF : 0x00;
+  }
+}
+
+#ifdef NES_RAM_SEARCH_AVX2
+// Unsigned byte comparisons from min / max: a <= b when min(a, b) == a
+__attribute__((target("avx2"))) void filterAVX2(const uint8_t *a, const uint8_t *b, uint8_t *mask,
+                                                std::size_t size, RamSearch::Compare op) {
+  const __m256i ones = _mm256_set1_epi8(-1);
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    __m256i keep;
+    switch (op) {
+    case RamSearch::Compare::Equal:
+      keep = _mm256_cmpeq_epi8(x, y);
+      break;
+    case RamSearch::Compare::NotEqual:
+      keep = _mm256_xor_si256(_mm256_cmpeq_epi8(x, y), ones);
+      break;
+    case RamSearch::Compare::LessEqual:
+      keep = _mm256_cmpeq_epi8(_mm256_min_epu8(x, y), x);
+      break;
+    case RamSearch::Compare::GreaterEqual:
+      keep = _mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x);
+      break;
+    case RamSearch::Compare::Less:
+      keep = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x), ones);
+      break;
+    case RamSearch::Compare::Greater:
+      keep = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, y), x), ones);
+      break;
+    default:
+      keep = _mm256_setzero_si256();
+    }
+    __m256i *out = reinterpret_cast<__m256i *>(mask + i);
+    _mm256_storeu_si256(out, _mm256_and_si256(_mm256_loadu_si256(out), keep));
+  }
+  filterScalar(a, b, mask, i, size, op);
+}
+#endif
+
+bool hasAVX2() {
+#ifdef NES_RAM_SEARCH_AVX2
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+RamSearch::RamSearch(bool simd) : use_simd(simd && hasAVX2()) {}
+
+void RamSearch::snapshot(NES &nes) {
+  std::span<const uint8_t> prg_ram = nes.getMapper().prgRAM();
+  std::vector<uint8_t> memory(0x800 + prg_ram.size());
+  std::copy_n(nes.getBus().getRAM(), 0x800, memory.begin());
+  std::copy(prg_ram.begin(), prg_ram.end(), memory.begin() + 0x800);
+  snapshot(memory.data(), memory.size());
+}
+
+void RamSearch::snapshot(const uint8_t *memory, std::size_t memory_size) {
+  if (size == 0) {
+    size = memory_size;
+    mask.assign(size, 0xFF);
+    constant.resize(size);
+  } else if (memory_size != size) {
+    throw std::runtime_error("RAM snapshot size mismatch");
+  }
+  history.insert(history.end(), memory, memory + memory_size);
+}
+
+void RamSearch::compare(Compare op, uint8_t value) {
+  if (snapshots() < 1) {
+    return;
+  }
+  std::fill(constant.begin(), constant.end(), value);
+  filter(newest(), constant.data(), op);
+}
+
+void RamSearch::compareLast(Compare op) {
+  if (snapshots() < 2) {
+    return;
+  }
+  filter(newest(), newest(1), op);
+}
+
+void RamSearch::compareAll(Compare op) {
+  for (std::size_t i = 1; i < snapshots(); i++) {
+    filter(&history[i * size], &history[(i - 1) * size], op);
+  }
+}
+
+void RamSearch::filter(const uint8_t *a, const uint8_t *b, Compare op) {
+#ifdef NES_RAM_SEARCH_AVX2
+  if (use_simd) {
+    filterAVX2(a, b, mask.data(), size, op);
+    return;
+  }
+#endif
+  filterScalar(a, b, mask.data(), 0, size, op);
+}
+
+std::size_t RamSearch::candidateCount() const {
+  return std::count(mask.begin(), mask.end(), 0xFF);
+}
+
+std::vector<uint16_t> RamSearch::candidates() const {
+  std::vector<uint16_t> addresses;
+  for (std::size_t i = 0; i < size; i++) {
+    if (mask[i]) {
+      addresses.push_back(address(i));
+    }
+  }
+  return addresses;
+}
+
+uint8_t RamSearch::value(uint16_t cpu_address) const {
+  std::size_t index = cpu_address < 0x2000 ? cpu_address % 0x800 : 0x800 + (cpu_address - 0x6000);
+  if (snapshots() == 0 || index >= size) {
+    throw std::out_of_range("Address outside of the RAM snapshots");
+  }
+  return newest()[index];
+}
+
+void RamSearch::reset() {
+  size = 0;
+  history.clear();
+  mask.clear();
+  constant.clear();
+}
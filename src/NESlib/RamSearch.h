@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class NES;
+
+/**
+ Search for the addresses of game variables (lives, score, position...)
+ by filtering candidates on how their value evolves across snapshots of
+ the internal RAM and cartridge PRG RAM.
+
+ Every address starts as a candidate. Filters keep those whose newest
+ value compares to a constant ("equals 3"), to the previous snapshot
+ ("decreased"), or between every pair of consecutive snapshots ("never
+ increased"). Filters compare 32 addresses per instruction with AVX2 when
+ the host supports it, plain loops otherwise.
+
+ Snapshot layout: internal RAM $0000 - $07FF, then PRG RAM from $6000.
+ */
+class RamSearch {
+public:
+  enum class Compare { Equal, NotEqual, Less, Greater, LessEqual, GreaterEqual };
+
+  // simd false forces the portable filters
+  explicit RamSearch(bool simd = true);
+
+  // Capture the machine memory. The first snapshot sets the memory size
+  // and makes every address a candidate.
+  void snapshot(NES &nes);
+  // Same from raw memory, in snapshot layout, of the size of the first one
+  void snapshot(const uint8_t *memory, std::size_t size);
+
+  // Keep candidates whose newest value compares to value
+  void compare(Compare op, uint8_t value);
+  // Keep candidates whose newest value compares to the previous one
+  void compareLast(Compare op);
+  // Keep candidates for which op holds between every pair of consecutive
+  // snapshots, e.g. LessEqual for a value that never increased
+  void compareAll(Compare op);
+
+  std::size_t snapshots() const { return size ? history.size() / size : 0; }
+  std::size_t candidateCount() const;
+  // CPU addresses of the remaining candidates, in increasing order
+  std::vector<uint16_t> candidates() const;
+  // Newest value of a CPU address
+  uint8_t value(uint16_t address) const;
+
+  // Forget snapshots and candidates
+  void reset();
+  // Whether filters run with AVX2
+  bool simd() const { return use_simd; }
+
+private:
+  static uint16_t address(std::size_t index) {
+    return index < 0x800 ? index : 0x6000 + (index - 0x800);
+  }
+  const uint8_t *newest(std::size_t back = 0) const {
+    return &history[history.size() - (back + 1) * size];
+  }
+  void filter(const uint8_t *a, const uint8_t *b, Compare op);
+
+  bool use_simd;
+  std::size_t size{};
+  std::vector<uint8_t> history; // Snapshots, oldest first
+  std::vector<uint8_t> mask;    // 0xFF for candidates
+  std::vector<uint8_t> constant;
+};
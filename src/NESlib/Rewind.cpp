@@ -0,0 +1,165 @@
+#include <cstring>
+
+#include "Rewind.h"
+
+namespace {
+
+void putVarint(std::vector<uint8_t> &out, std::size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+std::size_t getVarint(const uint8_t *&in) {
+  std::size_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t byte = *in++;
+    value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+}
+
+} // namespace
+
+RewindBuffer::RewindBuffer(std::size_t capacity) : ring(capacity) {}
+
+void RewindBuffer::push(const std::vector<uint8_t> &state, const std::vector<StateRange> *changed) {
+  if (newest.size() != state.size()) {
+    // First state, or a different machine
+    clear();
+    newest = state;
+    changed_valid = true;
+    return;
+  }
+
+  scratch.clear();
+  std::size_t last = 0;
+  if (changed && changed_valid) {
+    for (const StateRange &range : *changed) {
+      encode(newest.data(), state.data(), range, last, scratch);
+      std::memcpy(&newest[range.offset], &state[range.offset], range.size);
+    }
+  } else {
+    encode(newest.data(), state.data(), StateRange{0, state.size()}, last, scratch);
+    std::memcpy(newest.data(), state.data(), state.size());
+  }
+  changed_valid = true;
+  store(scratch);
+}
+
+bool RewindBuffer::pop(std::vector<uint8_t> &state) {
+  if (newest.empty()) {
+    return false;
+  }
+  state = newest;
+  // The caller's changed ranges now follow the state handed back, not the
+  // older newest
+  changed_valid = false;
+  if (deltas.empty()) {
+    newest.clear();
+    return true;
+  }
+  const Delta &delta = deltas.back();
+  apply(&ring[delta.offset], delta.size, newest.data());
+  tail = delta.offset;
+  deltas.pop_back();
+  return true;
+}
+
+std::size_t RewindBuffer::used() const {
+  std::size_t total = 0;
+  for (const Delta &delta : deltas) {
+    total += delta.size;
+  }
+  return total;
+}
+
+void RewindBuffer::clear() {
+  changed_valid = false;
+  deltas.clear();
+  tail = 0;
+  newest.clear();
+}
+
+void RewindBuffer::store(const std::vector<uint8_t> &delta) {
+  std::size_t size = delta.size();
+  if (size > ring.size()) {
+    // Cannot link the newest state to older ones anymore
+    deltas.clear();
+    tail = 0;
+    return;
+  }
+
+  std::size_t offset = tail;
+  if (offset + size > ring.size()) {
+    // Wrap around. Deltas between tail and the end are older than those
+    // at the start, they go first.
+    while (!deltas.empty() && deltas.front().offset >= tail) {
+      deltas.pop_front();
+    }
+    offset = 0;
+  }
+  while (!deltas.empty() && deltas.front().offset < offset + size &&
+         offset < deltas.front().offset + deltas.front().size) {
+    deltas.pop_front();
+  }
+
+  std::memcpy(&ring[offset], delta.data(), size);
+  deltas.push_back(Delta{offset, size});
+  tail = offset + size;
+}
+
+void RewindBuffer::encode(const uint8_t *older, const uint8_t *newer, const StateRange &range,
+                          std::size_t &last, std::vector<uint8_t> &out) {
+  // last is the end of the previous token, skips are counted from there
+  std::size_t i = range.offset;
+  std::size_t size = range.offset + range.size;
+  while (i < size) {
+    // Unchanged bytes, a word at a time
+    while (i + 8 <= size) {
+      uint64_t a, b;
+      std::memcpy(&a, older + i, 8);
+      std::memcpy(&b, newer + i, 8);
+      if (a != b) {
+        break;
+      }
+      i += 8;
+    }
+    while (i < size && older[i] == newer[i]) {
+      i++;
+    }
+    if (i == size) {
+      break; // Trailing unchanged bytes need no token
+    }
+
+    // Changed bytes, absorbing single unchanged bytes between them
+    std::size_t changed = i;
+    while (i < size && (older[i] != newer[i] || (i + 1 < size && older[i + 1] != newer[i + 1]))) {
+      i++;
+    }
+    putVarint(out, changed - last);
+    putVarint(out, i - changed);
+    for (std::size_t j = changed; j < i; j++) {
+      out.push_back(older[j] ^ newer[j]);
+    }
+    last = i;
+  }
+}
+
+void RewindBuffer::apply(const uint8_t *delta, std::size_t size, uint8_t *state) {
+  const uint8_t *end = delta + size;
+  std::size_t position = 0;
+  while (delta < end) {
+    position += getVarint(delta);
+    std::size_t count = getVarint(delta);
+    for (std::size_t i = 0; i < count; i++) {
+      state[position + i] ^= delta[i];
+    }
+    delta += count;
+    position += count;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Serializer.h"
+
+/**
+ Rewind history of machine states, see NES::saveState.
+
+ Only the newest state is kept whole. Each older one is stored as the XOR
+ of itself with its successor, run-length encoded: consecutive frames
+ differ by a few hundred bytes, so a delta is mostly runs of zeros.
+ Deltas live in a fixed-size byte ring, the oldest ones are dropped to
+ make room.
+
+ Delta encoding, repeated until the end of the state:
+   varint  count of unchanged bytes
+   varint  count of changed bytes, followed by their XOR
+ */
+class RewindBuffer {
+public:
+  explicit RewindBuffer(std::size_t capacity);
+
+  // Record a state, one per frame typically. When given, changed lists
+  // the only ranges that can differ from the previous state, as returned
+  // by NES::updateState. Right after pop() or clear() it is ignored: the
+  // ranges are relative to the popped state, not to the newest one left.
+  void push(const std::vector<uint8_t> &state, const std::vector<StateRange> *changed = nullptr);
+  // Take back the newest state, false when the history is empty
+  bool pop(std::vector<uint8_t> &state);
+
+  // States that can be popped
+  std::size_t size() const { return newest.empty() ? 0 : deltas.size() + 1; }
+  // Ring bytes used by deltas
+  std::size_t used() const;
+  void clear();
+
+private:
+  struct Delta {
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  static void encode(const uint8_t *older, const uint8_t *newer, const StateRange &range,
+                     std::size_t &last, std::vector<uint8_t> &out);
+  static void apply(const uint8_t *delta, std::size_t size, uint8_t *state);
+  void store(const std::vector<uint8_t> &delta);
+
+  std::vector<uint8_t> ring;
+  std::size_t tail{}; // End of the newest delta in the ring
+  std::deque<Delta> deltas;
+  std::vector<uint8_t> newest;
+  bool changed_valid = false; // newest is what the caller last pushed
+  std::vector<uint8_t> scratch;
+};
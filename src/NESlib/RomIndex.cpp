@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include "RomIndex.h"
+#include "StateHash.h"
+#include "WorkPool.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NES_CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[9] = {'N', 'E', 'S', 'R', 'O', 'M', 'I', 'X', 1};
+constexpr std::size_t ENTRY_SIZE = 48;
+
+// table[k][b]: CRC register after byte b followed by k zero bytes
+struct CrcTables {
+  uint32_t table[8][256];
+
+  CrcTables() {
+    for (uint32_t b = 0; b < 256; b++) {
+      uint32_t crc = b;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+      }
+      table[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+      for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = table[k - 1][b];
+        table[k][b] = (crc >> 8) ^ table[0][crc & 0xFF];
+      }
+    }
+  }
+};
+
+const CrcTables tables;
+
+// Register update without the initial and final inversions
+uint32_t crcSlice8(uint32_t crc, const uint8_t *p, std::size_t size) {
+  const auto &t = tables.table;
+  for (; size >= 8; p += 8, size -= 8) {
+    uint32_t lo, hi;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; size > 0; p++, size--) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+  }
+  return crc;
+}
+
+#ifdef NES_CRC32_PCLMUL
+__attribute__((target("pclmul"))) inline __m128i fold(__m128i x, __m128i k, __m128i next) {
+  __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+  __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(lo, hi), next);
+}
+
+// Folds 64 bytes at a time into four 128-bit lanes, then the lanes into
+// one. What remains has the CRC of the data folded into it, so the tables
+// finish from its 16 bytes. Constants are x^n mod P for the fold distances,
+// from the Intel paper "Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ Instruction". size must be at least 64.
+__attribute__((target("pclmul"))) uint32_t crcFold(uint32_t crc, const uint8_t *p, std::size_t size) {
+  auto load = [](const uint8_t *at) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(at)); };
+  const __m128i k12 = _mm_set_epi64x(0x1C6E41596, 0x154442BD4);
+  const __m128i k34 = _mm_set_epi64x(0x0CCAA009E, 0x1751997D0);
+
+  __m128i x0 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i x1 = load(p + 16);
+  __m128i x2 = load(p + 32);
+  __m128i x3 = load(p + 48);
+  p += 64;
+  size -= 64;
+  for (; size >= 64; p += 64, size -= 64) {
+    x0 = fold(x0, k12, load(p));
+    x1 = fold(x1, k12, load(p + 16));
+    x2 = fold(x2, k12, load(p + 32));
+    x3 = fold(x3, k12, load(p + 48));
+  }
+  x1 = fold(x0, k34, x1);
+  x2 = fold(x1, k34, x2);
+  x3 = fold(x2, k34, x3);
+  for (; size >= 16; p += 16, size -= 16) {
+    x3 = fold(x3, k34, load(p));
+  }
+
+  uint8_t folded[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(folded), x3);
+  return crcSlice8(crcSlice8(0, folded, sizeof(folded)), p, size);
+}
+#endif
+
+bool hasPCLMUL() {
+#ifdef NES_CRC32_PCLMUL
+  return __builtin_cpu_supports("pclmul");
+#else
+  return false;
+#endif
+}
+
+template <typename T> void put(uint8_t *&out, T value) {
+  std::memcpy(out, &value, sizeof(T));
+  out += sizeof(T);
+}
+
+template <typename T> T get(const uint8_t *&in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+}
+
+bool isRomFile(const std::filesystem::path &path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == ".nes";
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
+  if (!file) {
+    throw CartridgeError(CartridgeError::Kind::FileNotFound, "Cannot open " + path.string());
+  }
+  auto size = file.tellg();
+  if (size < 0) {
+    throw CartridgeError(CartridgeError::Kind::FileNotFound, "Cannot read " + path.string());
+  }
+  std::vector<uint8_t> image(static_cast<std::size_t>(size));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(image.data()), image.size());
+  return image;
+}
+
+} // namespace
+
+uint32_t crc32(const void *data, std::size_t size, uint32_t crc) {
+#ifdef NES_CRC32_PCLMUL
+  static const bool use_pclmul = hasPCLMUL();
+  if (use_pclmul && size >= 64) {
+    return ~crcFold(~crc, static_cast<const uint8_t *>(data), size);
+  }
+#endif
+  return crc32Portable(data, size, crc);
+}
+
+uint32_t crc32Portable(const void *data, std::size_t size, uint32_t crc) {
+  return ~crcSlice8(~crc, static_cast<const uint8_t *>(data), size);
+}
+
+RomIndex::RomIndex(std::vector<Entry> entries) : sorted(std::move(entries)) {
+  std::sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) {
+    return a.hash != b.hash ? a.hash < b.hash : a.path < b.path;
+  });
+}
+
+RomIndex::Entry RomIndex::identify(std::span<const uint8_t> image) {
+  Entry entry;
+  entry.header = CartridgeHeader::parse(image.data(), image.size());
+  std::size_t offset = CartridgeHeader::size + (entry.header.trainer ? CartridgeHeader::trainer_size : 0);
+  // parse() checked the image holds both ROMs
+  const uint8_t *roms = image.data() + offset;
+  std::size_t size = entry.header.prg_rom_size + entry.header.chr_rom_size;
+  entry.hash = hash64(roms, size);
+  entry.crc = crc32(roms, size);
+  return entry;
+}
+
+RomIndex::Entry RomIndex::identify(Cartridge &cartridge) {
+  const std::vector<uint8_t> &prg = cartridge.getPRG_ROM();
+  const std::vector<uint8_t> &chr = cartridge.getCHR_ROM();
+  std::vector<uint8_t> roms(prg);
+  roms.insert(roms.end(), chr.begin(), chr.end());
+
+  Entry entry;
+  entry.header = cartridge.getHeader();
+  entry.hash = hash64(roms.data(), roms.size());
+  entry.crc = crc32(prg.data(), prg.size());
+  entry.crc = crc32(chr.data(), chr.size(), entry.crc);
+  return entry;
+}
+
+RomIndex RomIndex::scan(const std::filesystem::path &root, unsigned threads, ScanStats *stats) {
+  namespace fs = std::filesystem;
+  std::vector<fs::path> files;
+  for (const auto &item : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied)) {
+    if (item.is_regular_file() && isRomFile(item.path())) {
+      files.push_back(item.path());
+    }
+  }
+
+  // Reading dominates, the walk above only lists directories
+  std::vector<std::optional<Entry>> found(files.size());
+  WorkPool pool(threads);
+  pool.parallelFor(files.size(), [&](std::size_t i, unsigned) {
+    try {
+      Entry entry = identify(readFile(files[i]));
+      entry.path = files[i].lexically_relative(root).generic_string();
+      found[i] = std::move(entry);
+    } catch (const CartridgeError &) {
+      // Not a ROM, counted below
+    }
+  });
+
+  std::vector<Entry> entries;
+  for (auto &entry : found) {
+    if (entry) {
+      entries.push_back(std::move(*entry));
+    }
+  }
+  if (stats) {
+    stats->files = files.size();
+    stats->skipped = files.size() - entries.size();
+  }
+  return RomIndex(std::move(entries));
+}
+
+void RomIndex::save(std::ostream &out) const {
+  std::vector<uint8_t> table(sizeof(MAGIC) + 4 + sorted.size() * ENTRY_SIZE);
+  uint8_t *p = table.data();
+  std::memcpy(p, MAGIC, sizeof(MAGIC));
+  p += sizeof(MAGIC);
+  put<uint32_t>(p, static_cast<uint32_t>(sorted.size()));
+
+  std::string paths;
+  for (const Entry &entry : sorted) {
+    const CartridgeHeader &h = entry.header;
+    put<uint64_t>(p, entry.hash);
+    put<uint32_t>(p, entry.crc);
+    put<uint32_t>(p, static_cast<uint32_t>(paths.size()));
+    put<uint16_t>(p, static_cast<uint16_t>(entry.path.size()));
+    put<uint16_t>(p, h.mapper);
+    put<uint8_t>(p, h.submapper);
+    put<uint8_t>(p, static_cast<uint8_t>(static_cast<uint8_t>(h.mirroring) | h.battery << 2 | h.trainer << 3 |
+                                         h.nes2 << 4));
+    put<uint8_t>(p, h.console_type);
+    put<uint8_t>(p, h.timing);
+    for (std::size_t size : {h.prg_rom_size, h.chr_rom_size, h.prg_ram_size, h.prg_nvram_size, h.chr_ram_size,
+                             h.chr_nvram_size}) {
+      put<uint32_t>(p, static_cast<uint32_t>(size));
+    }
+    paths += entry.path;
+  }
+
+  out.write(reinterpret_cast<const char *>(table.data()), table.size());
+  out.write(paths.data(), paths.size());
+}
+
+RomIndex RomIndex::load(std::istream &in) {
+  std::vector<uint8_t> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  if (data.size() < sizeof(MAGIC) + 4 || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a ROM index");
+  }
+  const uint8_t *p = data.data() + sizeof(MAGIC);
+  std::size_t count = get<uint32_t>(p);
+  std::size_t paths = sizeof(MAGIC) + 4 + count * ENTRY_SIZE;
+  if (data.size() < paths) {
+    throw std::runtime_error("Truncated ROM index");
+  }
+
+  std::vector<Entry> entries(count);
+  for (Entry &entry : entries) {
+    CartridgeHeader &h = entry.header;
+    entry.hash = get<uint64_t>(p);
+    entry.crc = get<uint32_t>(p);
+    std::size_t path_offset = get<uint32_t>(p);
+    std::size_t path_size = get<uint16_t>(p);
+    h.mapper = get<uint16_t>(p);
+    h.submapper = get<uint8_t>(p);
+    uint8_t flags = get<uint8_t>(p);
+    h.mirroring = static_cast<Mirroring>(flags & 0x03);
+    h.battery = flags & 0x04;
+    h.trainer = flags & 0x08;
+    h.nes2 = flags & 0x10;
+    h.console_type = get<uint8_t>(p);
+    h.timing = get<uint8_t>(p);
+    for (std::size_t *size : {&h.prg_rom_size, &h.chr_rom_size, &h.prg_ram_size, &h.prg_nvram_size,
+                              &h.chr_ram_size, &h.chr_nvram_size}) {
+      *size = get<uint32_t>(p);
+    }
+    if (paths + path_offset + path_size > data.size()) {
+      throw std::runtime_error("Truncated ROM index");
+    }
+    entry.path.assign(reinterpret_cast<const char *>(&data[paths + path_offset]), path_size);
+  }
+  return RomIndex(std::move(entries));
+}
+
+std::span<const RomIndex::Entry> RomIndex::find(uint64_t hash) const {
+  auto first = std::lower_bound(sorted.begin(), sorted.end(), hash,
+                                [](const Entry &entry, uint64_t key) { return entry.hash < key; });
+  auto last = std::upper_bound(first, sorted.end(), hash,
+                               [](uint64_t key, const Entry &entry) { return key < entry.hash; });
+  return {first, last};
+}
+
+std::vector<const RomIndex::Entry *> RomIndex::findCRC(uint32_t crc) const {
+  std::vector<const Entry *> matches;
+  for (const Entry &entry : sorted) {
+    if (entry.crc == crc) {
+      matches.push_back(&entry);
+    }
+  }
+  return matches;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Cartridge.h"
+
+/**
+ CRC-32 as zlib computes it (reflected 0x04C11DB7), the checksum ROM
+ databases list. crc continues a previous call. Uses PCLMULQDQ folding when
+ the CPU has it, slicing-by-8 tables otherwise; crc32Portable forces the
+ tables.
+ */
+uint32_t crc32(const void *data, std::size_t size, uint32_t crc = 0);
+uint32_t crc32Portable(const void *data, std::size_t size, uint32_t crc = 0);
+
+/**
+ ROM library indexed by content, see src/romindex.cpp.
+
+ A ROM is identified by its PRG and CHR ROM taken as one block, without the
+ iNES header and trainer, the way ROM databases identify dumps: a file with
+ a wrong or missing header entry still matches. hash is the XXH64 of that
+ block, the lookup key; crc its CRC-32, to match external databases. Each
+ entry keeps the decoded header of the file it was indexed from.
+
+ Index file, little endian
+ --------------------------
+ "NESROMIX" + version byte (1), entry count (32-bit)
+ entries sorted by hash, 48 bytes each:
+   hash (64), crc (32), path offset (32), path length (16), mapper (16),
+   submapper, flags (bits 0-1 mirroring, 2 battery, 3 trainer, 4 NES 2.0),
+   console type, timing (8 each),
+   PRG ROM, CHR ROM, PRG RAM, PRG NVRAM, CHR RAM, CHR NVRAM sizes (32 each)
+ then the paths, relative to the indexed directory
+ */
+class RomIndex {
+public:
+  struct Entry {
+    uint64_t hash{};
+    uint32_t crc{};
+    CartridgeHeader header;
+    std::string path;
+  };
+
+  struct ScanStats {
+    std::size_t files{};   // .nes files found
+    std::size_t skipped{}; // Unreadable or rejected by CartridgeHeader::parse
+  };
+
+  RomIndex() = default;
+  // Sorts entries by hash
+  explicit RomIndex(std::vector<Entry> entries);
+
+  // Key of a whole iNES image, path left empty. Throws CartridgeError.
+  static Entry identify(std::span<const uint8_t> image);
+  // Key of a loaded cartridge, header taken from it
+  static Entry identify(Cartridge &cartridge);
+
+  // Index every .nes file under root, reading and hashing on threads
+  // workers
+  static RomIndex scan(const std::filesystem::path &root, unsigned threads, ScanStats *stats = nullptr);
+
+  void save(std::ostream &out) const;
+  // Throws std::runtime_error when the stream is not a valid index
+  static RomIndex load(std::istream &in);
+
+  // Entries with this hash, several when a ROM is stored more than once
+  std::span<const Entry> find(uint64_t hash) const;
+  // Linear search, for hashes coming from a CRC-32 database
+  std::vector<const Entry *> findCRC(uint32_t crc) const;
+
+  const std::vector<Entry> &entries() const { return sorted; }
+  std::size_t size() const { return sorted.size(); }
+
+private:
+  std::vector<Entry> sorted;
+};
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <utility>
+
+#include "Scheduler.h"
+
+void Scheduler::setHandler(EventType type, Handler handler) {
+  handlers[static_cast<std::size_t>(type)] = std::move(handler);
+}
+
+void Scheduler::schedule(EventType type, uint64_t timestamp) {
+  auto index = static_cast<std::size_t>(type);
+  // Invalidate the previous entry of this type, if any
+  ++generation[index];
+  deadlines[index] = timestamp;
+  heap.push_back(Entry{timestamp, generation[index], type});
+  std::push_heap(heap.begin(), heap.end(), later);
+}
+
+void Scheduler::cancel(EventType type) {
+  auto index = static_cast<std::size_t>(type);
+  ++generation[index];
+  deadlines[index] = NEVER;
+}
+
+bool Scheduler::isScheduled(EventType type) const {
+  return deadline(type) != NEVER;
+}
+
+uint64_t Scheduler::deadline(EventType type) const {
+  return deadlines[static_cast<std::size_t>(type)];
+}
+
+uint64_t Scheduler::nextDeadline() {
+  dropStale();
+  return heap.empty() ? NEVER : heap.front().timestamp;
+}
+
+void Scheduler::dispatch(uint64_t now) {
+  while (nextDeadline() <= now) {
+    Entry entry = heap.front();
+    std::pop_heap(heap.begin(), heap.end(), later);
+    heap.pop_back();
+
+    auto index = static_cast<std::size_t>(entry.type);
+    deadlines[index] = NEVER;
+    if (handlers[index]) {
+      handlers[index](entry.timestamp);
+    }
+  }
+}
+
+void Scheduler::serialize(Serializer &s) {
+  std::array<uint64_t, nbEvents> pending = deadlines;
+  s.array(pending);
+  if (s.loading()) {
+    heap.clear();
+    for (std::size_t i = 0; i < nbEvents; i++) {
+      if (pending[i] == NEVER) {
+        cancel(static_cast<EventType>(i));
+      } else {
+        schedule(static_cast<EventType>(i), pending[i]);
+      }
+    }
+  }
+}
+
+void Scheduler::dropStale() {
+  while (!heap.empty()) {
+    const Entry &top = heap.front();
+    auto index = static_cast<std::size_t>(top.type);
+    if (top.generation == generation[index] && deadlines[index] == top.timestamp) {
+      return;
+    }
+    std::pop_heap(heap.begin(), heap.end(), later);
+    heap.pop_back();
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "Serializer.h"
+
+/**
+ Components that can request to be woken up at a given master cycle.
+ */
+enum class EventType : uint8_t {
+  PPU, // Next line or vblank work, see PPU::advance
+  APU_FRAME_IRQ,
+  DMC_FETCH,
+  MAPPER_IRQ,
+  COUNT
+};
+
+/**
+ Master clock event scheduler.
+
+ Timestamps are expressed in master clock cycles (21.477272 MHz on NTSC).
+ A CPU cycle lasts 12 master cycles and a PPU dot 4, so every component
+ can be expressed on the same timeline without rounding.
+
+ Each event type has at most one pending deadline: scheduling it again
+ moves it. Events live in a binary min-heap; moved or cancelled entries are
+ discarded lazily when they reach the top.
+ */
+class Scheduler {
+public:
+  using Handler = std::function<void(uint64_t timestamp)>;
+
+  Scheduler() { deadlines.fill(NEVER); }
+
+  static constexpr uint64_t CPU_DIVIDER = 12;
+  static constexpr uint64_t PPU_DIVIDER = 4;
+  static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+  void setHandler(EventType type, Handler handler);
+
+  void schedule(EventType type, uint64_t timestamp);
+  void cancel(EventType type);
+  bool isScheduled(EventType type) const;
+  uint64_t deadline(EventType type) const;
+
+  // Earliest pending timestamp, NEVER when nothing is scheduled
+  uint64_t nextDeadline();
+
+  // Run the handlers of every event due at or before now, in order.
+  // Handlers may schedule further events, including due ones.
+  void dispatch(uint64_t now);
+
+  // Pending deadlines, handlers are left untouched
+  void serialize(Serializer &s);
+
+private:
+  struct Entry {
+    uint64_t timestamp;
+    uint32_t generation;
+    EventType type;
+  };
+  static bool later(const Entry &a, const Entry &b) {
+    return a.timestamp > b.timestamp;
+  }
+  void dropStale();
+
+  static constexpr std::size_t nbEvents = static_cast<std::size_t>(EventType::COUNT);
+
+  std::vector<Entry> heap;
+  std::array<uint32_t, nbEvents> generation{};
+  std::array<uint64_t, nbEvents> deadlines{};
+  std::array<Handler, nbEvents> handlers{};
+};
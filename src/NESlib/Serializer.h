@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Byte range of a machine state
+struct StateRange {
+  std::size_t offset;
+  std::size_t size;
+};
+
+/**
+ Flat binary machine state.
+
+ Components describe their state once, in a serialize(Serializer &)
+ method, which is used both to save and to restore it. The layout only
+ depends on the machine configuration, so two states of the same machine
+ have the same size and can be compared or XORed byte for byte.
+
+ Large memories go through blocks() with the DirtyBitmap of their writes.
+ An updater brings an up to date state back in sync by only copying their
+ dirty blocks (and whatever differs elsewhere), and lists the ranges that
+ changed. A resetter does the reverse, bringing the machine back to the
+ state it was last synced with by only loading the dirty blocks. Every mode
+ clears the bitmaps: afterwards, they track changes relative to the state
+ just saved, loaded, updated or reset to.
+ */
+class Serializer {
+public:
+  static Serializer saver(std::vector<uint8_t> &buffer) {
+    buffer.clear();
+    return Serializer(Mode::Save, &buffer, nullptr, 0, nullptr);
+  }
+  static Serializer loader(const std::vector<uint8_t> &buffer) {
+    return Serializer(Mode::Load, nullptr, buffer.data(), buffer.size(), nullptr);
+  }
+  // state must be the buffer the machine was last synced with, unmodified
+  static Serializer resetter(const std::vector<uint8_t> &state) {
+    return Serializer(Mode::Reset, nullptr, state.data(), state.size(), nullptr);
+  }
+  // changed may be null
+  static Serializer updater(std::vector<uint8_t> &state, std::vector<StateRange> *changed) {
+    return Serializer(Mode::Update, &state, nullptr, state.size(), changed);
+  }
+
+  bool loading() const { return mode == Mode::Load || mode == Mode::Reset; }
+
+  void bytes(void *data, std::size_t size) {
+    switch (mode) {
+    case Mode::Save: {
+      auto *begin = static_cast<const uint8_t *>(data);
+      output->insert(output->end(), begin, begin + size);
+      return;
+    }
+    case Mode::Load:
+    case Mode::Reset:
+      reserve(size);
+      std::memcpy(data, input, size);
+      input += size;
+      return;
+    case Mode::Update: {
+      std::size_t offset = position();
+      reserve(size);
+      update(offset, data, size);
+      return;
+    }
+    }
+  }
+
+  template <typename T> void value(T &data) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    bytes(&data, sizeof(T));
+  }
+
+  template <typename T, std::size_t N> void array(std::array<T, N> &data) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    bytes(data.data(), N * sizeof(T));
+  }
+
+  // A memory whose writes are tracked in dirty
+  template <typename Bitmap> void blocks(uint8_t *data, Bitmap &dirty) {
+    if (mode == Mode::Reset) {
+      reserve(Bitmap::SIZE);
+      dirty.forEach([&](std::size_t block) {
+        std::size_t offset = block * Bitmap::BLOCK;
+        std::memcpy(data + offset, input + offset, std::min(Bitmap::BLOCK, Bitmap::SIZE - offset));
+      });
+      input += Bitmap::SIZE;
+    } else if (mode != Mode::Update) {
+      bytes(data, Bitmap::SIZE);
+    } else {
+      std::size_t start = position();
+      reserve(Bitmap::SIZE);
+      dirty.forEach([&](std::size_t block) {
+        std::size_t offset = block * Bitmap::BLOCK;
+        update(start + offset, data + offset, std::min(Bitmap::BLOCK, Bitmap::SIZE - offset));
+      });
+    }
+    dirty.clear();
+  }
+
+  // Fails on states from a differently configured machine
+  void finish() const {
+    if (mode != Mode::Save && remaining != 0) {
+      throw std::runtime_error("Machine state size mismatch");
+    }
+  }
+
+private:
+  enum class Mode { Save, Load, Update, Reset };
+
+  Serializer(Mode mode, std::vector<uint8_t> *output, const uint8_t *input,
+             std::size_t remaining, std::vector<StateRange> *changed)
+      : mode(mode), output(output), input(input), remaining(remaining), changed(changed) {}
+
+  std::size_t position() const { return output->size() - remaining; }
+
+  void reserve(std::size_t size) {
+    if (size > remaining) {
+      throw std::runtime_error("Truncated machine state");
+    }
+    remaining -= size;
+  }
+
+  void update(std::size_t offset, const void *data, std::size_t size) {
+    uint8_t *target = output->data() + offset;
+    if (std::memcmp(target, data, size) == 0) {
+      return;
+    }
+    std::memcpy(target, data, size);
+    if (!changed) {
+      return;
+    }
+    if (!changed->empty() && changed->back().offset + changed->back().size == offset) {
+      changed->back().size += size;
+    } else {
+      changed->push_back(StateRange{offset, size});
+    }
+  }
+
+  Mode mode;
+  std::vector<uint8_t> *output;
+  const uint8_t *input;
+  std::size_t remaining;
+  std::vector<StateRange> *changed;
+};
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "StateHash.h"
+
+namespace {
+
+constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+constexpr char MAGIC[8] = {'N', 'E', 'S', 'H', 'A', 'S', 'H', 1};
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Little endian hosts only, like the rest of the state code
+inline uint64_t read64(const uint8_t *p) {
+  uint64_t value;
+  std::memcpy(&value, p, 8);
+  return value;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * P2;
+  return rotl(acc, 31) * P1;
+}
+
+inline uint64_t merge(uint64_t acc, uint64_t lane) {
+  acc ^= round(0, lane);
+  return acc * P1 + P4;
+}
+
+} // namespace
+
+uint64_t hash64(const void *data, std::size_t size, uint64_t seed) {
+  auto *p = static_cast<const uint8_t *>(data);
+  const uint8_t *end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    // Four independent lanes keep the multipliers busy
+    uint64_t v1 = seed + P1 + P2;
+    uint64_t v2 = seed + P2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - P1;
+    do {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+      p += 32;
+    } while (end - p >= 32);
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  } else {
+    h = seed + P5;
+  }
+  h += size;
+
+  while (end - p >= 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * P1 + P4;
+    p += 8;
+  }
+  if (end - p >= 4) {
+    uint32_t word;
+    std::memcpy(&word, p, 4);
+    h ^= word * P1;
+    h = rotl(h, 23) * P2 + P3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= *p++ * P5;
+    h = rotl(h, 11) * P1;
+  }
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t zobristHash(uint32_t base, const uint8_t *data, std::size_t size) {
+  uint64_t hash = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= zobrist(base + i, data[i]);
+  }
+  return hash;
+}
+
+HashStreamWriter::HashStreamWriter(std::ostream &out) : out(out) {
+  out.write(MAGIC, sizeof(MAGIC));
+}
+
+void HashStreamWriter::write(const FrameHash &record) {
+  out.write(reinterpret_cast<const char *>(&record.frame), 8);
+  out.write(reinterpret_cast<const char *>(&record.hash), 8);
+}
+
+HashStreamReader::HashStreamReader(std::istream &in) : in(in) {
+  char magic[sizeof(MAGIC)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a state hash stream");
+  }
+}
+
+bool HashStreamReader::read(FrameHash &record) {
+  char raw[16];
+  if (!in.read(raw, sizeof(raw))) {
+    return false;
+  }
+  record.frame = read64(reinterpret_cast<const uint8_t *>(raw));
+  record.hash = read64(reinterpret_cast<const uint8_t *>(raw + 8));
+  return true;
+}
+
+std::optional<HashMismatch> compareHashStreams(std::istream &first, std::istream &second) {
+  HashStreamReader a(first);
+  HashStreamReader b(second);
+  FrameHash x{};
+  FrameHash y{};
+  std::optional<uint64_t> last_match;
+  while (true) {
+    bool more_a = a.read(x);
+    bool more_b = b.read(y);
+    if (!more_a && !more_b) {
+      return std::nullopt;
+    }
+    if (more_a != more_b) {
+      const FrameHash &extra = more_a ? x : y;
+      return HashMismatch{HashMismatch::Kind::Length, extra.frame, more_a ? x.hash : 0,
+                          more_b ? y.hash : 0, more_a, last_match};
+    }
+    if (x.frame != y.frame) {
+      return HashMismatch{HashMismatch::Kind::Frame, std::min(x.frame, y.frame), x.frame, y.frame,
+                          false, last_match};
+    }
+    if (x.hash != y.hash) {
+      return HashMismatch{HashMismatch::Kind::Hash, x.frame, x.hash, y.hash, false, last_match};
+    }
+    last_match = x.frame;
+  }
+}
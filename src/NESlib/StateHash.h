@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+
+/**
+ Deterministic machine state hashing, to check that two builds or two
+ hosts run a replay identically without storing whole frames.
+
+ hash64 is XXH64 (https://xxhash.com), fast enough to hash every frame.
+ NES::stateHash applies it to NES::saveState, which covers the CPU
+ registers, RAM, PPU and mapper state.
+
+ Hash stream file
+ --------------------------
+ "NESHASH" + version byte (1)
+ then per frame: frame number, hash, both 64-bit little endian
+ */
+uint64_t hash64(const void *data, std::size_t size, uint64_t seed = 0);
+
+/**
+ Zobrist hashing of machine memories, see NES::fingerprint.
+
+ A memory hashes to the XOR of one key per byte, keyed on the byte
+ position and value. A write updates it in O(1) by XORing out the key of
+ the old value and XORing in the new one. Keys come from a splitmix64
+ finalizer rather than a table: a few multiplies cost less than the cache
+ misses of a table covering every position and value.
+
+ Each memory keys its bytes from its own base position, so equal bytes at
+ the same offset of two memories do not cancel out.
+ */
+namespace Zobrist {
+constexpr uint32_t RAM = 0x00000;
+constexpr uint32_t NAMETABLES = 0x10000;
+constexpr uint32_t PALETTE = 0x20000;
+constexpr uint32_t OAM = 0x30000;
+constexpr uint32_t CHR_RAM = 0x40000;
+constexpr uint32_t PRG_RAM = 0x50000;
+} // namespace Zobrist
+
+inline uint64_t zobrist(uint32_t position, uint8_t value) {
+  uint64_t x = ((static_cast<uint64_t>(position) << 8) | value) + 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Zobrist hash of a whole memory, its first byte at position base
+uint64_t zobristHash(uint32_t base, const uint8_t *data, std::size_t size);
+
+struct FrameHash {
+  uint64_t frame;
+  uint64_t hash;
+};
+
+class HashStreamWriter {
+public:
+  explicit HashStreamWriter(std::ostream &out);
+  void write(const FrameHash &record);
+
+private:
+  std::ostream &out;
+};
+
+class HashStreamReader {
+public:
+  // Throws std::runtime_error when the stream is not a hash stream
+  explicit HashStreamReader(std::istream &in);
+  // False at the end of the stream
+  bool read(FrameHash &record);
+
+private:
+  std::istream &in;
+};
+
+struct HashMismatch {
+  enum class Kind {
+    Hash,   // Same frame, different states
+    Frame,  // The streams do not record the same frames
+    Length, // One stream ends early, frame is the first missing one
+  };
+  Kind kind;
+  uint64_t frame;  // For Frame mismatches, the first frame only one stream records
+  uint64_t first;  // Hash, or frame number for Frame mismatches
+  uint64_t second;
+  bool first_longer = false;          // Length mismatches: the first stream has the extra frames
+  std::optional<uint64_t> last_match; // Last frame both streams record with the same hash
+};
+
+// First difference between two hash streams, nothing when they match
+std::optional<HashMismatch> compareHashStreams(std::istream &first, std::istream &second);
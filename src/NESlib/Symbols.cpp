@@ -0,0 +1,87 @@
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "Symbols.h"
+
+namespace {
+
+// Width of the dot-padded name column in asm6502 listings
+constexpr std::size_t listing_name_width = 32;
+
+bool parseHex(const std::string &text, uint16_t &value) {
+  std::size_t start = (!text.empty() && text[0] == '$') ? 1 : 0;
+  if (start >= text.size() || text.size() - start > 4) {
+    return false;
+  }
+  for (std::size_t i = start; i < text.size(); i++) {
+    if (!std::isxdigit(static_cast<unsigned char>(text[i]))) {
+      return false;
+    }
+  }
+  value = static_cast<uint16_t>(std::stoul(text.substr(start), nullptr, 16));
+  return true;
+}
+
+} // namespace
+
+void SymbolTable::add(const std::string &name, uint16_t address) {
+  // Keep the first label of an address, later ones are usually local
+  names.emplace(address, name);
+  addresses.emplace(name, address);
+}
+
+void SymbolTable::load(std::istream &in) {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.size() > listing_name_width && line.find(" LBL ") != std::string::npos) {
+      // asm6502 listing: name padded with ". " up to the address column
+      std::string name = line.substr(0, listing_name_width);
+      name.erase(name.find_last_not_of(". ") + 1);
+      std::istringstream fields(line.substr(listing_name_width));
+      std::string hex;
+      uint16_t address;
+      if (!name.empty() && fields >> hex && parseHex(hex, address)) {
+        add(name, address);
+      }
+      continue;
+    }
+
+    std::istringstream fields(line);
+    std::string name, hex, extra;
+    uint16_t address;
+    if (fields >> name >> hex && !(fields >> extra) &&
+        (std::isalpha(static_cast<unsigned char>(name[0])) || name[0] == '_') &&
+        parseHex(hex, address)) {
+      add(name, address);
+    }
+  }
+}
+
+bool SymbolTable::loadFile(const std::string &filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    return false;
+  }
+  load(file);
+  return true;
+}
+
+std::string SymbolTable::name(uint16_t address) const {
+  auto symbol = names.find(address);
+  if (symbol != names.end()) {
+    return symbol->second;
+  }
+  char hex[6];
+  std::snprintf(hex, sizeof(hex), "$%04X", address);
+  return hex;
+}
+
+std::optional<uint16_t> SymbolTable::address(const std::string &name) const {
+  auto symbol = addresses.find(name);
+  if (symbol == addresses.end()) {
+    return std::nullopt;
+  }
+  return symbol->second;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <optional>
+#include <string>
+
+/**
+ Label -> address table used to name guest routines in reports.
+
+ Reads the symbol section of an asm6502 listing (asm6502 -l), e.g.
+
+   reset. . . . . . . . . . . . . . 8000  32768  LBL WORD  main.asm:2
+
+ as well as plain "name address" lines, addresses in hexadecimal with an
+ optional '$' prefix. Only labels are kept, variables are ignored.
+ */
+class SymbolTable {
+public:
+  void add(const std::string &name, uint16_t address);
+  void load(std::istream &in);
+  // Returns false when the file cannot be opened
+  bool loadFile(const std::string &filename);
+
+  bool empty() const { return names.empty(); }
+  // Label at address, or "$XXXX" when there is none
+  std::string name(uint16_t address) const;
+  std::optional<uint16_t> address(const std::string &name) const;
+
+private:
+  std::map<uint16_t, std::string> names;
+  std::map<std::string, uint16_t> addresses;
+};
@@ -0,0 +1,116 @@
+#include "NES.h"
+#include "StateHash.h"
+#include "TranspositionTable.h"
+
+namespace {
+
+// Fingerprint 0 would read as an empty slot
+inline uint64_t entryKey(uint64_t fingerprint) { return fingerprint ? fingerprint : 1; }
+
+inline uint32_t digestOf(uint64_t data) { return static_cast<uint32_t>(data >> 32); }
+inline uint32_t depthOf(uint64_t data) { return static_cast<uint32_t>(data); }
+
+} // namespace
+
+TranspositionTable::TranspositionTable(std::size_t capacity) {
+  std::size_t count = 1;
+  while (count * BUCKET < capacity) {
+    count *= 2;
+  }
+  buckets = std::make_unique<Bucket[]>(count);
+  mask = count - 1;
+  slot_count = count * BUCKET;
+}
+
+bool TranspositionTable::insert(uint64_t fingerprint, uint32_t digest, uint32_t depth) {
+  uint64_t key = entryKey(fingerprint);
+  uint64_t data = (static_cast<uint64_t>(digest) << 32) | depth;
+  Bucket &entries = bucket(key);
+
+  for (;;) {
+    Slot *match = nullptr;
+    uint64_t match_data = 0;
+    // Replace an empty slot first, else the deepest entry
+    Slot *victim = nullptr;
+    uint64_t victim_data = 0;
+    uint64_t victim_rank = 0;
+    for (Slot &slot : entries.slots) {
+      uint64_t stored = slot.data.load(std::memory_order_acquire);
+      uint64_t stored_key = slot.check.load(std::memory_order_acquire) ^ stored;
+      if (stored_key == key && digestOf(stored) == digest) {
+        if (!match || depthOf(stored) < depthOf(match_data)) {
+          match = &slot;
+          match_data = stored;
+        }
+        continue;
+      }
+      uint64_t rank = stored_key == 0 ? UINT64_MAX : depthOf(stored);
+      if (!victim || rank > victim_rank) {
+        victim = &slot;
+        victim_data = stored;
+        victim_rank = rank;
+      }
+    }
+
+    if (match) {
+      // Keep the earliest depth
+      if (depthOf(match_data) <= depth) {
+        return false;
+      }
+      victim = match;
+      victim_data = match_data;
+    }
+    // Lost to another writer: read the bucket again
+    if (victim->data.compare_exchange_strong(victim_data, data, std::memory_order_acq_rel)) {
+      victim->check.store(key ^ data, std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+bool TranspositionTable::lookup(uint64_t fingerprint, uint32_t digest, uint32_t &depth) const {
+  uint64_t key = entryKey(fingerprint);
+  bool found = false;
+  for (const Slot &slot : bucket(key).slots) {
+    uint64_t stored = slot.data.load(std::memory_order_acquire);
+    if ((slot.check.load(std::memory_order_acquire) ^ stored) != key || digestOf(stored) != digest) {
+      continue;
+    }
+    // Racing inserts can leave the same state in two slots
+    if (!found || depthOf(stored) < depth) {
+      depth = depthOf(stored);
+      found = true;
+    }
+  }
+  return found;
+}
+
+uint32_t TranspositionTable::digest(NES &nes) {
+  auto registers = nes.getCPU().dumpRegisters();
+  uint8_t cpu[] = {
+      registers.A, registers.X, registers.Y, static_cast<uint8_t>(registers.PC),
+      static_cast<uint8_t>(registers.PC >> 8), registers.SP,
+  };
+  // Another seed than NES::fingerprint, so both do not collide together
+  uint64_t seed = hash64(cpu, sizeof(cpu), 0x5EED);
+  return static_cast<uint32_t>(hash64(nes.getBus().getRAM(), 0x800, seed));
+}
+
+std::size_t TranspositionTable::count() const {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i <= mask; i++) {
+    for (const Slot &slot : buckets[i].slots) {
+      total += (slot.check.load(std::memory_order_relaxed) ^ slot.data.load(std::memory_order_relaxed)) != 0;
+    }
+  }
+  return total;
+}
+
+void TranspositionTable::clear() {
+  for (std::size_t i = 0; i <= mask; i++) {
+    for (Slot &slot : buckets[i].slots) {
+      slot.check.store(0, std::memory_order_relaxed);
+      slot.data.store(0, std::memory_order_relaxed);
+    }
+  }
+}
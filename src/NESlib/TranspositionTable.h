@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class NES;
+
+/**
+ Set of machine states already reached by an input search, shared by its
+ worker threads without locks.
+
+ States are identified by NES::fingerprint and verified against a 32-bit
+ digest computed independently of it (see digest()), so a fingerprint
+ collision alone does not prune a branch. Each entry keeps the earliest
+ depth (frame) the state was reached at: reaching it again later adds
+ nothing to the search.
+
+ Each slot holds its data word and the fingerprint XORed with it
+ (lockless hashing, Hyatt & Mann): a reader recovers the fingerprint from
+ both words, so a slot caught halfway through a write reads as another
+ state, and no thread ever waits for another. Writers replace the data
+ word by compare-and-swap against the value they read, then store the
+ check word; the depth of a recorded state only ever decreases. Inserts
+ of the same state racing with each other can record it in two slots,
+ lookup() and insert() then go by the earliest depth of both. The table
+ is lossy on purpose when a bucket is full: its deepest entry is
+ replaced, which, like a write torn by such a replacement, only costs
+ re-simulating a duplicate branch.
+ */
+class TranspositionTable {
+public:
+  // Capacity is rounded up to a power of two, at least one bucket
+  explicit TranspositionTable(std::size_t capacity);
+
+  // Record a state reached at depth. Returns false when it was already
+  // reached at the same depth or earlier, and the branch can be pruned.
+  bool insert(uint64_t fingerprint, uint32_t digest, uint32_t depth);
+  // Earliest depth a state was reached at, false when it is not recorded
+  bool lookup(uint64_t fingerprint, uint32_t digest, uint32_t &depth) const;
+
+  // Verification digest of a machine: internal RAM and CPU registers
+  static uint32_t digest(NES &nes);
+
+  std::size_t capacity() const { return slot_count; }
+  // Entries in the table, counts every slot
+  std::size_t count() const;
+  // Not thread-safe
+  void clear();
+
+private:
+  static constexpr std::size_t BUCKET = 4; // Slots per 64-byte cache line
+
+  struct Slot {
+    std::atomic<uint64_t> check{}; // Fingerprint ^ data, 0 when empty
+    std::atomic<uint64_t> data{};  // digest << 32 | depth
+  };
+
+  struct alignas(64) Bucket {
+    Slot slots[BUCKET];
+  };
+
+  Bucket &bucket(uint64_t fingerprint) const { return buckets[fingerprint & mask]; }
+
+  std::unique_ptr<Bucket[]> buckets;
+  std::size_t mask;
+  std::size_t slot_count;
+};
@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "WorkPool.h"
+
+WorkPool::WorkPool(unsigned workers) {
+  workers = std::max(workers, 1u);
+  for (unsigned i = 0; i < workers; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 1; i < workers; i++) {
+    threads.emplace_back(&WorkPool::loop, this, i);
+  }
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void WorkPool::parallelFor(std::size_t count, const Task &job) {
+  std::size_t workers = queues.size();
+  for (std::size_t w = 0; w < workers; w++) {
+    std::lock_guard<std::mutex> guard(queues[w]->lock);
+    for (std::size_t i = w * count / workers; i < (w + 1) * count / workers; i++) {
+      queues[w]->indices.push_back(i);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    task = &job;
+    error = nullptr;
+    running = static_cast<unsigned>(threads.size());
+    generation++;
+  }
+  wake.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> guard(lock);
+  finished.wait(guard, [this] { return running == 0; });
+  task = nullptr;
+  if (error) {
+    std::exception_ptr thrown = error;
+    error = nullptr;
+    std::rethrow_exception(thrown);
+  }
+}
+
+void WorkPool::loop(unsigned worker) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait(guard, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+    work(worker);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      running--;
+    }
+    finished.notify_one();
+  }
+}
+
+void WorkPool::work(unsigned worker) {
+  std::size_t index;
+  while (take(worker, index)) {
+    try {
+      (*task)(index, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+}
+
+bool WorkPool::take(unsigned worker, std::size_t &index) {
+  {
+    Queue &own = *queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.indices.empty()) {
+      index = own.indices.back();
+      own.indices.pop_back();
+      return true;
+    }
+  }
+  for (std::size_t i = 1; i < queues.size(); i++) {
+    Queue &victim = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.indices.empty()) {
+      index = victim.indices.front();
+      victim.indices.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ Fixed set of worker threads running parallel loops, see InputSearch.
+
+ Each worker gets an equal share of the loop indices in its own queue and
+ takes from its back; a worker running out steals from the front of the
+ others, so uneven tasks (a branch running a longer frame) do not leave
+ threads idle. The calling thread is worker 0.
+ */
+class WorkPool {
+public:
+  using Task = std::function<void(std::size_t index, unsigned worker)>;
+
+  // At least one worker, the calling thread
+  explicit WorkPool(unsigned workers);
+  ~WorkPool();
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+  // Run task for every index in [0, count), returns once all are done.
+  // The first exception thrown by a task is rethrown here, the remaining
+  // tasks still run.
+  void parallelFor(std::size_t count, const Task &task);
+
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<std::size_t> indices;
+  };
+
+  void loop(unsigned worker);
+  void work(unsigned worker);
+  bool take(unsigned worker, std::size_t &index);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  const Task *task{};
+  uint64_t generation{};
+  unsigned running{}; // Background workers still on the current loop
+  bool stopping{};
+  std::exception_ptr error;
+};
@@ -6,14 +6,39 @@
 
 class DummyMapper : public Mapper {
 public:
-  DummyMapper() { memory.resize(0xFFFF - 0x4020 + 1); }
+  DummyMapper() {
+    memory.resize(0xFFFF - 0x4020 + 1);
+    chr.resize(0x2000);
+    hash = zobristHash(Zobrist::PRG_RAM, memory.data(), memory.size()) ^
+           zobristHash(Zobrist::CHR_RAM, chr.data(), chr.size());
+  }
 
   uint8_t readPRG(uint16_t address) { return memory.at(address - 0x4020); };
 
   void writePRG(uint16_t address, uint8_t value) {
-    memory.at(address - 0x4020) = value;
+    uint8_t &byte = memory.at(address - 0x4020);
+    hash ^= zobrist(Zobrist::PRG_RAM + address - 0x4020, byte) ^
+            zobrist(Zobrist::PRG_RAM + address - 0x4020, value);
+    byte = value;
   };
 
+  uint8_t readCHR(uint16_t address) { return chr[address & 0x1FFF]; }
+  void writeCHR(uint16_t address, uint8_t value) {
+    hash ^= zobrist(Zobrist::CHR_RAM + (address & 0x1FFF), chr[address & 0x1FFF]) ^
+            zobrist(Zobrist::CHR_RAM + (address & 0x1FFF), value);
+    chr[address & 0x1FFF] = value;
+  }
+
+  void serialize(Serializer &s) {
+    s.bytes(memory.data(), memory.size());
+    s.bytes(chr.data(), chr.size());
+    s.value(hash);
+  }
+
+  uint64_t fingerprint() { return hash; }
+
 private:
   std::vector<uint8_t> memory;
+  std::vector<uint8_t> chr;
+  uint64_t hash;
 };
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "../Cartridge.h"
+#include "../Serializer.h"
+#include "../StateHash.h"
 
 /**
 
@@ -11,6 +16,39 @@ https://www.nesdev.org/wiki/Board_table
  */
 class Mapper {
 public:
+    virtual ~Mapper() = default;
+
     virtual uint8_t readPRG(uint16_t address) = 0;
     virtual void writePRG(uint16_t address, uint8_t value) = 0;
+
+    // PRG bank currently mapped at a CPU address, lets tools tell apart
+    // code running from the same address in different banks
+    virtual uint16_t prgBank(uint16_t address) { return 0; }
+
+    // Cartridge RAM at $6000 - $7FFF, empty on boards without it
+    virtual std::span<const uint8_t> prgRAM() { return {}; }
+
+    // Keep battery backed RAM in a save file, see PrgRAM. False on boards
+    // without battery backed RAM.
+    virtual bool attachSaveFile(const std::string &path) { return false; }
+    // Called at frame boundaries to write the save file back
+    virtual void syncSave() {}
+
+    // Pattern tables, PPU $0000 - $1FFF
+    virtual uint8_t readCHR(uint16_t address) { return 0; }
+    virtual void writeCHR(uint16_t address, uint8_t value) {}
+
+    // Nametable layout, boards with mapper controlled mirroring override it
+    virtual Mirroring mirroring() { return Mirroring::Horizontal; }
+
+    // PPU address line A12 rose, MMC3-style boards count scanlines with it
+    virtual void ppuA12Rise() {}
+
+    // Banking registers and cartridge RAM, part of machine states
+    virtual void serialize(Serializer &s) {}
+
+    // Hash of the state serialize() covers, see NES::fingerprint. Called
+    // on every search step: boards keep it updated incrementally, going
+    // through a Serializer would clear their dirty bitmaps.
+    virtual uint64_t fingerprint() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include <map>
+#include <utility>
+
+#include "MapperFactory.h"
+#include "MapperNROM.h"
+
+namespace {
+
+struct Entry {
+    std::string name;
+    MapperFactory::Constructor constructor;
+};
+
+std::map<uint16_t, Entry> &registry() {
+    static std::map<uint16_t, Entry> entries{
+        {0, {"NROM", [](Cartridge *cart) { return std::make_unique<MapperNROM>(cart); }}},
+    };
+    return entries;
+}
+
+} // namespace
+
+std::unique_ptr<Mapper> MapperFactory::create(Cartridge *cart) {
+    uint16_t number = cart->getHeader().mapper;
+    auto entry = registry().find(number);
+    if (entry == registry().end()) {
+        throw CartridgeError(CartridgeError::Kind::UnsupportedMapper,
+                             "Unsupported mapper " + std::to_string(number));
+    }
+    return entry->second.constructor(cart);
+}
+
+void MapperFactory::registerMapper(uint16_t number, const std::string &name, Constructor constructor) {
+    registry()[number] = Entry{name, std::move(constructor)};
+}
+
+bool MapperFactory::supports(uint16_t number) {
+    return registry().count(number) != 0;
+}
+
+std::string MapperFactory::name(uint16_t number) {
+    auto entry = registry().find(number);
+    return entry == registry().end() ? "unknown" : entry->second.name;
+}
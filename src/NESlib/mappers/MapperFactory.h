@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "../Cartridge.h"
+#include "mappers/Mapper.h"
+
+/**
+ Builds the mapper matching a cartridge header.
+
+ Mappers register themselves by iNES number; create() throws a
+ CartridgeError of kind UnsupportedMapper for anything not registered.
+ https://www.nesdev.org/wiki/Mapper
+ */
+class MapperFactory {
+public:
+    using Constructor = std::function<std::unique_ptr<Mapper>(Cartridge *)>;
+
+    static std::unique_ptr<Mapper> create(Cartridge *cart);
+
+    static void registerMapper(uint16_t number, const std::string &name, Constructor constructor);
+    static bool supports(uint16_t number);
+    static std::string name(uint16_t number);
+};
@@ -1,27 +1,84 @@
+#include <algorithm>
+#include <bit>
 #include <cstdint>
-#include <iostream>
-#include <iomanip>
 #include "MapperNROM.h"
+#include "Log.h"
 
+namespace {
 
-template<typename T>
-std::string print_hex(T a, int size) {
-    std::stringstream ss;
-    ss << std::setw(size) << std::setfill('0') << std::hex << (int) a;
-    return ss.str();
+// NROM has no RAM, except on the odd board (Family Basic) whose header
+// declares some. iNES 1.0 always infers 8kB, only trust it with a battery.
+std::size_t ramSize(const CartridgeHeader &header) {
+    if (!header.nes2 && !header.battery) {
+        return 0;
+    }
+    std::size_t size = header.prg_ram_size + header.prg_nvram_size;
+    return size == 0 ? 0 : std::min(std::bit_ceil(size), PrgRAM::SIZE);
+}
+
+} // namespace
+
+MapperNROM::MapperNROM(Cartridge* cart): cart(cart), prg_ram(ramSize(cart->getHeader())) {
+    if (cart->getCHR_ROM().empty()) {
+        chr_ram.resize(0x2000, 0);
+        chr_hash = zobristHash(Zobrist::CHR_RAM, chr_ram.data(), chr_ram.size());
+    }
 }
 
 uint8_t MapperNROM::readPRG(uint16_t address) {
-    if (address <= 0xBFFF || address <= 0xFFFF && cart->extended()) {
+    if (address >= 0x6000 && address < 0x8000 && prg_ram.present()) {
+        return prg_ram.read(address);
+    } else if (address < 0x8000) {
+        NES_LOG_TRACE(LogCategory::MAPPER, "Illegal PRG-ROM access at $%04X", address);
+    } else if (address <= 0xBFFF || cart->extended()) {
         return cart->getPRG_ROM()[address - 0x8000];
-    } else if (address >= 0xBFFF && !cart->extended()) { // Mirror $8000 for NROM-128
+    } else { // Mirror $8000 for NROM-128
         return cart->getPRG_ROM()[(address - 0x8000)%0x4000];
-    } else {
-        // std::cout << "illegal PRG-ROM access" << std::endl;
     }
     return 0x0;
 }
 
 void MapperNROM::writePRG(uint16_t address, uint8_t value) {
-    std::cout << "Tried to write PRG ROM..." << std::endl;
+    if (address >= 0x6000 && address < 0x8000 && prg_ram.present()) {
+        prg_ram.write(address, value);
+        return;
+    }
+    NES_LOG_DEBUG(LogCategory::MAPPER, "Ignored write of $%02X to PRG ROM at $%04X", value, address);
+}
+
+void MapperNROM::serialize(Serializer &s) {
+    if (!chr_ram.empty()) {
+        s.blocks(chr_ram.data(), chr_dirty);
+    }
+    s.value(chr_hash);
+    if (prg_ram.present()) {
+        prg_ram.serialize(s);
+    }
+}
+
+bool MapperNROM::attachSaveFile(const std::string &path) {
+    if (!cart->getHeader().battery || !prg_ram.present()) {
+        return false;
+    }
+    prg_ram.attach(path);
+    return true;
+}
+
+uint8_t MapperNROM::readCHR(uint16_t address) {
+    if (!chr_ram.empty()) {
+        return chr_ram[address & 0x1FFF];
+    }
+    return cart->getCHR_ROM()[address & 0x1FFF];
+}
+
+void MapperNROM::writeCHR(uint16_t address, uint8_t value) {
+    if (!chr_ram.empty()) {
+        uint16_t offset = address & 0x1FFF;
+        chr_hash ^= zobrist(Zobrist::CHR_RAM + offset, chr_ram[offset]) ^
+                    zobrist(Zobrist::CHR_RAM + offset, value);
+        chr_ram[offset] = value;
+        chr_dirty.mark(offset);
+    } else {
+        NES_LOG_DEBUG(LogCategory::MAPPER, "Ignored write of $%02X to CHR ROM at $%04X", value, address);
+    }
 }
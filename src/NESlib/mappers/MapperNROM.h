@@ -2,9 +2,12 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "../Cartridge.h"
+#include "../DirtyBitmap.h"
 #include "mappers/Mapper.h"
+#include "mappers/PrgRAM.h"
 
 /**
 
@@ -12,9 +15,22 @@ https://www.nesdev.org/wiki/Board_table
  */
 class MapperNROM : public Mapper {
 public:
-    MapperNROM(Cartridge* cart): cart(cart) {};
+    MapperNROM(Cartridge* cart);
     virtual uint8_t readPRG(uint16_t address);
     virtual void writePRG(uint16_t address, uint8_t value);
+    virtual uint8_t readCHR(uint16_t address);
+    virtual void writeCHR(uint16_t address, uint8_t value);
+    virtual std::span<const uint8_t> prgRAM() { return prg_ram.data(); }
+    virtual bool attachSaveFile(const std::string &path);
+    virtual void syncSave() { prg_ram.sync(); }
+    virtual Mirroring mirroring() { return cart->getHeader().mirroring; }
+    virtual void serialize(Serializer &s);
+    virtual uint64_t fingerprint() { return chr_hash ^ prg_ram.hash(); }
 private:
     Cartridge* cart;
+    std::vector<uint8_t> chr_ram; // Boards without CHR ROM
+    DirtyBitmap<0x2000, 64> chr_dirty;
+    uint64_t chr_hash{}; // Zobrist hash of chr_ram
+    PrgRAM prg_ram;      // Family Basic style boards
+
 };
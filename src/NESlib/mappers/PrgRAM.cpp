@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PrgRAM.h"
+
+PrgRAM::PrgRAM(std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+    owned.assign(SIZE, 0);
+    memory = owned.data();
+    mask = static_cast<uint16_t>(std::clamp<std::size_t>(size, 1, SIZE) - 1);
+    ram_hash = zobristHash(Zobrist::PRG_RAM, memory, SIZE);
+}
+
+PrgRAM::~PrgRAM() {
+    detach();
+}
+
+void PrgRAM::attach(const std::string &path) {
+    if (!present()) {
+        throw std::runtime_error("No cartridge RAM to back with " + path);
+    }
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat status {};
+    if (fd < 0 || fstat(fd, &status) != 0 ||
+        (static_cast<std::size_t>(status.st_size) < SIZE && ftruncate(fd, SIZE) != 0)) {
+        int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Cannot open save file " + path + ": " + std::strerror(error));
+    }
+    void *file = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    // The mapping keeps the file open
+    ::close(fd);
+    if (file == MAP_FAILED) {
+        throw std::runtime_error("Cannot map save file " + path + ": " + std::strerror(error));
+    }
+
+    // Bytes the file did not hold yet come from the RAM
+    std::vector<uint8_t> contents(memory, memory + SIZE);
+    auto *bytes = static_cast<uint8_t *>(file);
+    std::size_t saved = std::min(static_cast<std::size_t>(status.st_size), SIZE);
+    std::copy(contents.begin() + saved, contents.end(), bytes + saved);
+
+    detach();
+    mapping = file;
+    memory = bytes;
+    owned.clear();
+    owned.shrink_to_fit();
+    ram_hash = zobristHash(Zobrist::PRG_RAM, memory, SIZE);
+    dirty.markAll();
+    unsynced = true;
+}
+
+void PrgRAM::sync() {
+    if (mapping && unsynced) {
+        msync(mapping, SIZE, MS_ASYNC);
+        unsynced = false;
+    }
+}
+
+void PrgRAM::detach() {
+    if (mapping) {
+        owned.assign(memory, memory + SIZE);
+        memory = owned.data();
+        msync(mapping, SIZE, MS_ASYNC);
+        munmap(mapping, SIZE);
+        mapping = nullptr;
+    }
+}
+
+void PrgRAM::serialize(Serializer &s) {
+    s.blocks(memory, dirty);
+    s.value(ram_hash);
+    if (s.loading()) {
+        unsynced = true;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../DirtyBitmap.h"
+#include "../Serializer.h"
+#include "../StateHash.h"
+
+/**
+ Cartridge RAM at $6000 - $7FFF, see MapperNROM.
+
+ The whole 8kB window is always stored, boards with less RAM mirror it.
+ Battery backed RAM can be a shared mapping of its save file (attach):
+ writes land in the page cache and the kernel writes them back, so there
+ is no save step and no syscall per write. sync() only asks for an early
+ write-back (msync MS_ASYNC), NES::runFrame calls it once per frame.
+ Loading a machine state rewrites the save file too, as it would the RAM
+ of a real cartridge.
+ */
+class PrgRAM {
+public:
+    static constexpr std::size_t SIZE = 0x2000;
+
+    // No RAM
+    PrgRAM() = default;
+    // size is a power of two, up to SIZE. 0 is no RAM.
+    explicit PrgRAM(std::size_t size);
+    ~PrgRAM();
+    PrgRAM(const PrgRAM &) = delete;
+    PrgRAM &operator=(const PrgRAM &) = delete;
+
+    bool present() const { return memory != nullptr; }
+    uint8_t read(uint16_t address) const { return memory[address & mask]; }
+    void write(uint16_t address, uint8_t value) {
+        uint16_t offset = address & mask;
+        ram_hash ^= zobrist(Zobrist::PRG_RAM + offset, memory[offset]) ^ zobrist(Zobrist::PRG_RAM + offset, value);
+        memory[offset] = value;
+        dirty.mark(offset);
+        unsynced = true;
+    }
+
+    // Back the RAM with a save file. An existing file replaces the RAM
+    // contents, a missing one is created from them. Throws
+    // std::runtime_error.
+    void attach(const std::string &path);
+    bool attached() const { return mapping != nullptr; }
+    // Start writing back the changes since the last sync
+    void sync();
+
+    std::span<const uint8_t> data() const { return {memory, present() ? mask + std::size_t{1} : 0}; }
+    // Zobrist hash of the contents, see NES::fingerprint
+    uint64_t hash() const { return ram_hash; }
+    void serialize(Serializer &s);
+
+private:
+    void detach();
+
+    std::vector<uint8_t> owned; // Until a save file is attached
+    uint8_t *memory = nullptr;  // owned, or the save file mapping
+    void *mapping = nullptr;
+    uint16_t mask = 0;
+    DirtyBitmap<SIZE, 64> dirty;
+    uint64_t ram_hash{};
+    bool unsynced = false;
+};
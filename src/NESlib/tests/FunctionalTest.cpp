@@ -0,0 +1,107 @@
+/**
+ Runs a self-checking 6502 program until it traps and reports both the
+ outcome and the emulation throughput.
+
+ Runs tests/roms/cpu_selftest.asm by default, or Klaus Dormann's 6502
+ functional test (https://github.com/Klaus2m5/6502_65C02_functional_tests),
+ assembled with the in-tree asm6502, see the functional-test target in
+ CMakeLists.txt. The program runs on a DummyMapper, i.e. flat memory
+ over the whole cartridge space. Its asm6502 listing must define:
+
+   origin     address of the first byte of the image (default $8000)
+   start      entry point (default: origin)
+   success    the trap reached when every test passed
+
+ A trap is an instruction jumping to itself (JMP *, branch to itself);
+ the test signals a failure by trapping anywhere else.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NES.h"
+#include "Symbols.h"
+#include "mappers/DummyMapper.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <image.bin> <listing.lst> [max instructions]"
+              << std::endl;
+    return 2;
+  }
+
+  std::ifstream file(argv[1], std::ios_base::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 2;
+  }
+  std::vector<uint8_t> image{std::istreambuf_iterator<char>(file), {}};
+
+  SymbolTable symbols;
+  if (!symbols.loadFile(argv[2])) {
+    std::cerr << "Cannot open " << argv[2] << std::endl;
+    return 2;
+  }
+  auto success = symbols.address("success");
+  if (!success) {
+    std::cerr << "No 'success' label in " << argv[2] << std::endl;
+    return 2;
+  }
+  uint16_t origin = symbols.address("origin").value_or(0x8000);
+  uint16_t start = symbols.address("start").value_or(origin);
+  uint64_t limit = argc > 3 ? std::stoull(argv[3]) : 200'000'000;
+
+  NES nes(std::make_unique<DummyMapper>());
+  Bus &bus = nes.getBus();
+  CPU_6502 &cpu = nes.getCPU();
+  for (std::size_t i = 0; i < image.size() && origin + i <= 0xFFFF; i++) {
+    bus.writeByte(origin + i, image[i]);
+  }
+  bus.writeByte(0xFFFC, start & 0xFF);
+  bus.writeByte(0xFFFD, start >> 8);
+  cpu.reset();
+
+  uint64_t instructions = 0;
+  uint64_t first_cycle = cpu.getCycles();
+  uint16_t trap = 0;
+  bool trapped = false;
+
+  auto begin = std::chrono::steady_clock::now();
+  while (instructions < limit) {
+    uint16_t pc = cpu.dumpRegisters().PC;
+    cpu.step();
+    instructions++;
+    if (cpu.dumpRegisters().PC == pc) {
+      trap = pc;
+      trapped = true;
+      break;
+    }
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  uint64_t cycles = cpu.getCycles() - first_cycle;
+
+  bool passed = trapped && trap == *success;
+  if (!trapped) {
+    std::cout << "No trap after " << instructions << " instructions" << std::endl;
+  } else {
+    std::cout << (passed ? "Success" : "FAILURE") << ": trapped at "
+              << (passed ? "success" : symbols.name(trap)) << " after " << instructions
+              << " instructions" << std::endl;
+  }
+
+  // NTSC CPU clock: 1.789773 MHz
+  double mips = instructions / seconds / 1e6;
+  double realtime = cycles / seconds / 1789773.0;
+  std::cout << "instructions=" << instructions << " cycles=" << cycles
+            << " seconds=" << seconds << " mips=" << mips << " realtime=" << realtime << "x"
+            << std::endl;
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+TEST_CASE("OAM DMA copies a page to PPU OAM") {
+  SUBCASE("From internal RAM, stalling the CPU") {
+    auto fixture = TestFixture::setupTest({
+        "LDA #$03",
+        "STA $4014",
+        "NOP",
+    });
+    for (int i = 0; i < 0x100; i++) {
+      fixture.bus->writeByte(0x300 + i, i ^ 0x5A);
+    }
+
+    fixture.cpu->step(2);
+    uint64_t before = fixture.cpu->getCycles();
+    fixture.cpu->step();
+
+    // NOP takes 2 cycles, the DMA 513 or 514 depending on alignment
+    uint64_t elapsed = fixture.cpu->getCycles() - before;
+    CHECK(elapsed == 2 + 513 + (before & 1));
+    CHECK(fixture.bus->interrupts().state() == 0);
+    for (int i = 0; i < 0x100; i++) {
+      CHECK(fixture.bus->getPPU().getOAM()[i] == (i ^ 0x5A));
+    }
+  }
+
+  SUBCASE("From cartridge space, wrapping around OAMADDR") {
+    auto fixture = TestFixture::setupTest({});
+    for (int i = 0; i < 0x100; i++) {
+      fixture.bus->writeByte(0x6000 + i, i);
+    }
+
+    fixture.bus->writeByte(0x2003, 0x10); // OAMADDR
+    fixture.bus->writeByte(0x4014, 0x60);
+
+    const auto &oam = fixture.bus->getPPU().getOAM();
+    CHECK(oam[0x10] == 0x00);
+    CHECK(oam[0xFF] == 0xEF);
+    CHECK(oam[0x00] == 0xF0);
+    CHECK(oam[0x0F] == 0xFF);
+  }
+}
+
+TEST_CASE("Breakpoints and watchpoints stop debug runs") {
+  auto fixture = TestFixture::setupTest({
+      "LDA #$07",  // $800
+      "STA $0234", // $802
+      "LDX $0234", // $805
+      "INX",       // $808
+      "JMP $0808", // $809
+  });
+  auto &points = fixture.bus->breakpoints();
+  auto &cpu = *fixture.cpu;
+  uint64_t limit = cpu.getCycles() + 1000;
+
+  SUBCASE("Breakpoint on PC, resuming executes it") {
+    points.add(Breakpoints::EXECUTE, 0x808);
+    auto stop = cpu.runUntil(limit);
+    CHECK(stop.reason == CPU_6502::StopReason::Breakpoint);
+    CHECK(stop.address == 0x808);
+    CHECK(cpu.dumpRegisters().X == 0x07);
+
+    stop = cpu.runUntil(limit);
+    CHECK(stop.reason == CPU_6502::StopReason::Breakpoint);
+    CHECK(cpu.dumpRegisters().X == 0x08);
+
+    points.remove(Breakpoints::EXECUTE, 0x808);
+    CHECK(cpu.runUntil(limit).reason == CPU_6502::StopReason::Limit);
+  }
+
+  SUBCASE("Write watchpoint reports the value") {
+    points.add(Breakpoints::WRITE, 0x234);
+    auto stop = cpu.runUntil(limit);
+    CHECK(stop.reason == CPU_6502::StopReason::WriteWatchpoint);
+    CHECK(stop.address == 0x234);
+    CHECK(stop.value == 0x07);
+    CHECK(cpu.dumpRegisters().PC == 0x805);
+  }
+
+  SUBCASE("Read watchpoint") {
+    points.add(Breakpoints::READ, 0x234);
+    points.add(Breakpoints::READ, 0x235);
+    points.remove(Breakpoints::READ, 0x235);
+    auto stop = cpu.runUntil(limit);
+    CHECK(stop.reason == CPU_6502::StopReason::ReadWatchpoint);
+    CHECK(cpu.dumpRegisters().PC == 0x808);
+  }
+
+  SUBCASE("Watchpoints cover internal RAM mirrors") {
+    points.add(Breakpoints::WRITE, 0x1234);
+    auto stop = cpu.runUntil(limit);
+    CHECK(stop.reason == CPU_6502::StopReason::WriteWatchpoint);
+    CHECK(stop.address == 0x234);
+  }
+
+  SUBCASE("OAM DMA from internal RAM hits read watchpoints") {
+    points.add(Breakpoints::READ, 0x0B10);
+    fixture.bus->writeByte(0x4014, 0x03);
+    REQUIRE(points.triggered());
+    auto hit = points.takeHit();
+    CHECK(hit.kind == Breakpoints::READ);
+    CHECK(hit.address == 0x310);
+  }
+
+  SUBCASE("Predicate through the machine run loop") {
+    uint64_t master = fixture.nes->masterClock() + 1000 * Scheduler::CPU_DIVIDER;
+    auto stop = fixture.nes->runUntil(
+        master, [](const CPU_6502 &cpu) { return cpu.dumpRegisters().X == 0x10; });
+    CHECK(stop.reason == CPU_6502::StopReason::Predicate);
+    CHECK(cpu.dumpRegisters().X == 0x10);
+  }
+}
@@ -1126,4 +1126,55 @@ TEST_CASE("CPU supports all 6502 opcodes") {
       } // TODO : test overflow
     }
   }
-}
\ No newline at end of file
+}
+TEST_CASE("CPU services interrupt lines") {
+  auto fixture = TestFixture::setupTest({
+      "SEI",
+      "NOP",
+      "CLI",
+      "NOP",
+      "NOP",
+      "LDA #$42", // Handler at $805
+      "RTI",
+  });
+
+  uint16_t handler = 0x805;
+  fixture.bus->writeByte(0xFFFA, handler & 0xFF);
+  fixture.bus->writeByte(0xFFFB, handler >> 8);
+  fixture.bus->writeByte(0xFFFE, handler & 0xFF);
+  fixture.bus->writeByte(0xFFFF, handler >> 8);
+  fixture.cpu->reset();
+  auto &lines = fixture.bus->interrupts();
+
+  SUBCASE("IRQ is masked by the interrupt disable flag") {
+    fixture.cpu->step();
+    lines.setIRQ(InterruptLines::IRQ_MAPPER, true);
+    fixture.cpu->step();
+    CHECK(fixture.cpu->dumpRegisters().PC == 0x802);
+
+    // CLI, then the pending IRQ is taken instead of the next NOP
+    fixture.cpu->step(2);
+    CHECK(fixture.cpu->dumpRegisters().PC == handler);
+    CHECK(fixture.cpu->dumpRegisters().flags[I_f]);
+    CHECK_FALSE(fixture.cpu->dumpRegisters().flags[B_f]);
+    CHECK(fixture.cpu->dumpRegisters().SP == 0xFD - 3);
+
+    // Level triggered: still asserted, but masked while in the handler
+    fixture.cpu->step();
+    CHECK(fixture.cpu->dumpRegisters().A == 0x42);
+    lines.setIRQ(InterruptLines::IRQ_MAPPER, false);
+    fixture.cpu->step(2);
+    CHECK(fixture.cpu->dumpRegisters().PC == 0x804);
+  }
+
+  SUBCASE("NMI ignores the interrupt disable flag and is latched once") {
+    fixture.cpu->step();
+    lines.triggerNMI();
+    fixture.cpu->step();
+    CHECK(fixture.cpu->dumpRegisters().PC == handler);
+    CHECK(lines.state() == 0);
+
+    fixture.cpu->step(2);
+    CHECK(fixture.cpu->dumpRegisters().PC == 0x801);
+  }
+}
@@ -0,0 +1,209 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Cartridge.h"
+#include "NES.h"
+#include "doctest.h"
+#include "mappers/MapperFactory.h"
+
+namespace {
+
+std::vector<uint8_t> makeImage(std::vector<uint8_t> header, std::size_t payload) {
+  header.resize(CartridgeHeader::size, 0);
+  header.resize(CartridgeHeader::size + payload, 0xEA);
+  return header;
+}
+
+std::string writeImage(const std::vector<uint8_t> &image) {
+  auto path = std::filesystem::temp_directory_path() / "coro_nes_test.nes";
+  std::ofstream file(path, std::ios_base::binary);
+  file.write(reinterpret_cast<const char *>(image.data()), image.size());
+  return path.string();
+}
+
+} // namespace
+
+TEST_CASE("iNES header parsing") {
+  SUBCASE("Flags 6 and 7") {
+    auto image = makeImage({'N', 'E', 'S', 0x1A, 2, 1, 0x17, 0x40}, 0);
+    auto header = CartridgeHeader::parse(image.data(), 0x10 + 0x200 + 0x8000 + 0x2000);
+
+    CHECK_FALSE(header.nes2);
+    CHECK(header.mapper == 0x41);
+    CHECK(header.mirroring == Mirroring::Vertical);
+    CHECK(header.battery);
+    CHECK(header.trainer);
+    CHECK(header.prg_rom_size == 0x8000);
+    CHECK(header.chr_rom_size == 0x2000);
+    CHECK(header.prg_nvram_size == 0x2000);
+  }
+
+  SUBCASE("NES 2.0 extended sizes and mapper") {
+    auto image = makeImage({'N', 'E', 'S', 0x1A, 0x02, 0x00, 0x08, 0x18, 0x51,
+                            0x00, 0x07, 0x70, 0x01},
+                           0);
+    auto header = CartridgeHeader::parse(image.data(), 0x10 + 0x8000);
+
+    CHECK(header.nes2);
+    CHECK(header.mapper == 0x110);
+    CHECK(header.submapper == 5);
+    CHECK(header.mirroring == Mirroring::FourScreen);
+    CHECK(header.prg_ram_size == 64 << 7);
+    CHECK(header.chr_nvram_size == 64 << 7);
+    CHECK(header.timing == 1);
+  }
+
+  SUBCASE("NES 2.0 exponent-multiplier ROM size") {
+    // 2^14 * (1*2+1) = 48kB
+    auto image = makeImage({'N', 'E', 'S', 0x1A, 0b00111001, 0, 0, 0x08, 0,
+                            0x0F},
+                           0);
+    auto header = CartridgeHeader::parse(image.data(), 0x10 + 0xC000);
+    CHECK(header.prg_rom_size == 0xC000);
+  }
+}
+
+TEST_CASE("Corrupt images are rejected") {
+  auto kindOf = [](const std::vector<uint8_t> &image, std::size_t size) {
+    try {
+      CartridgeHeader::parse(image.data(), size);
+    } catch (const CartridgeError &e) {
+      return e.kind();
+    }
+    FAIL("no error raised");
+    return CartridgeError::Kind::Corrupt;
+  };
+
+  auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1}, 0);
+  CHECK(kindOf(image, 0x08) == CartridgeError::Kind::Truncated);
+  CHECK(kindOf(image, 0x10 + 0x4000) == CartridgeError::Kind::Truncated);
+
+  auto bad = makeImage({'N', 'E', 'Z', 0x1A, 1, 1}, 0);
+  CHECK(kindOf(bad, 0x10 + 0x6000) == CartridgeError::Kind::BadMagic);
+
+  auto empty = makeImage({'N', 'E', 'S', 0x1A, 0, 1}, 0);
+  CHECK(kindOf(empty, 0x10 + 0x2000) == CartridgeError::Kind::Corrupt);
+}
+
+TEST_CASE("Mapper factory builds the mapper from the header") {
+  SUBCASE("NROM-128 is mirrored") {
+    auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1}, 0x4000 + 0x2000);
+    image[0x10] = 0x42;
+    Cartridge cart{writeImage(image)};
+    auto mapper = MapperFactory::create(&cart);
+
+    CHECK(mapper->readPRG(0x8000) == 0x42);
+    CHECK(mapper->readPRG(0xC000) == 0x42);
+  }
+
+  SUBCASE("Unknown mapper fails fast") {
+    auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1, 0xF0}, 0x4000 + 0x2000);
+    Cartridge cart{writeImage(image)};
+
+    CHECK_THROWS_AS(MapperFactory::create(&cart), CartridgeError);
+  }
+
+  SUBCASE("Missing file") {
+    CHECK_THROWS_AS(Cartridge{"/nonexistent/rom.nes"}, CartridgeError);
+  }
+}
+
+TEST_CASE("Images in memory load like files") {
+  auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1, 0x04}, 0x200 + 0x4000 + 0x2000);
+  image[0x10] = 0x11;                 // Trainer
+  image[0x210] = 0x42;                // PRG ROM
+  image[0x210 + 0x4000] = 0x24;       // CHR ROM
+  Cartridge fromFile{writeImage(image)};
+
+  auto same = [&](Cartridge &cart) {
+    CHECK(cart.getTrainer() == fromFile.getTrainer());
+    CHECK(cart.getPRG_ROM() == fromFile.getPRG_ROM());
+    CHECK(cart.getCHR_ROM() == fromFile.getCHR_ROM());
+    CHECK(cart.getPRG_ROM()[0] == 0x42);
+    CHECK(cart.getCHR_ROM()[0] == 0x24);
+  };
+
+  SUBCASE("Borrowed") {
+    Cartridge cart{std::span<const uint8_t>(image)};
+    same(cart);
+  }
+
+  SUBCASE("Owned") {
+    Cartridge cart{std::vector<uint8_t>(image)};
+    same(cart);
+  }
+
+  SUBCASE("Truncated") {
+    std::span<const uint8_t> shorter(image.data(), image.size() - 1);
+    CHECK_THROWS_AS(Cartridge{shorter}, CartridgeError);
+    CHECK_THROWS_AS(Cartridge{std::span<const uint8_t>(image.data(), 4)}, CartridgeError);
+  }
+}
+
+TEST_CASE("Battery RAM lives in its save file") {
+  auto path = std::filesystem::temp_directory_path() / "coro_nes_test.sav";
+  std::filesystem::remove(path);
+  auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1, 0x02}, 0x4000 + 0x2000);
+
+  SUBCASE("Boards without battery have no RAM") {
+    auto plain = makeImage({'N', 'E', 'S', 0x1A, 1, 1}, 0x4000 + 0x2000);
+    auto nes = NES::fromImage(plain);
+    nes->getBus().writeByte(0x6000, 0x42);
+    CHECK(nes->getBus().readByte(0x6000) == 0);
+    CHECK(nes->getMapper().prgRAM().empty());
+    CHECK_FALSE(nes->attachSaveFile(path.string()));
+    CHECK_FALSE(std::filesystem::exists(path));
+  }
+
+  SUBCASE("Writes reach the file and come back") {
+    {
+      auto nes = NES::fromImage(image);
+      auto &bus = nes->getBus();
+      uint64_t empty = nes->fingerprint();
+      bus.writeByte(0x6000, 0x42);
+      CHECK(bus.readByte(0x6000) == 0x42);
+      CHECK(nes->getMapper().prgRAM().size() == 0x2000);
+      CHECK(nes->getMapper().prgRAM()[0] == 0x42);
+      CHECK(nes->fingerprint() != empty);
+
+      // Created from the RAM contents
+      REQUIRE(nes->attachSaveFile(path.string()));
+      CHECK(std::filesystem::file_size(path) == 0x2000);
+      bus.writeByte(0x7FFF, 0x24);
+      nes->runFrame();
+
+      std::vector<uint8_t> state;
+      nes->saveState(state);
+      bus.writeByte(0x7FFF, 0x99);
+      nes->loadState(state);
+      CHECK(bus.readByte(0x7FFF) == 0x24);
+    }
+
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<uint8_t> saved(std::istreambuf_iterator<char>(file), {});
+    REQUIRE(saved.size() == 0x2000);
+    CHECK(saved[0] == 0x42);
+    CHECK(saved[0x1FFF] == 0x24);
+
+    // An existing file replaces the RAM
+    auto nes = NES::fromImage(image);
+    nes->getBus().writeByte(0x6000, 0x11);
+    REQUIRE(nes->attachSaveFile(path.string()));
+    CHECK(nes->getBus().readByte(0x6000) == 0x42);
+    CHECK(nes->getBus().readByte(0x7FFF) == 0x24);
+
+    // Same contents, same fingerprint, however they were loaded
+    auto other = NES::fromImage(image);
+    other->getBus().writeByte(0x6000, 0x42);
+    other->getBus().writeByte(0x7FFF, 0x24);
+    CHECK(other->fingerprint() == nes->fingerprint());
+  }
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,74 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <sys/shm.h>
+#include <vector>
+
+#include "Coverage.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+TEST_CASE("Coverage counts control transfer edges") {
+  auto fixture = TestFixture::setupTest({
+      "LDX #$03",
+      "DEX",           // $802
+      "BNE %11111101", // $803, back to DEX
+      "JSR $0809",     // $805
+      "NOP",           // $808
+      "RTS",           // $809
+  });
+  CoverageMap coverage;
+  fixture.cpu->attachCoverage(&coverage);
+  fixture.cpu->step(1 + 3 * 2 + 2);
+
+  // Taken and not taken branches are different edges
+  CoverageMap expected;
+  expected.edge(0x803, 0x802);
+  expected.edge(0x803, 0x802);
+  expected.edge(0x803, 0x805);
+  expected.edge(0x805, 0x809);
+  expected.edge(0x809, 0x808);
+  CHECK(coverage.edges() == 4);
+  CHECK(std::equal(coverage.data(), coverage.data() + coverage.size(), expected.data()));
+
+  SUBCASE("Detached coverage no longer counts") {
+    coverage.clear();
+    fixture.cpu->attachCoverage(nullptr);
+    fixture.cpu->reset();
+    fixture.cpu->step(9);
+    CHECK(coverage.edges() == 0);
+  }
+}
+
+TEST_CASE("Coverage maps can be borrowed or shared with AFL") {
+  std::vector<uint8_t> counters(1024);
+  CoverageMap borrowed(counters.data(), counters.size());
+  borrowed.edge(0x8000, 0x8010);
+  CHECK(borrowed.size() == 1024);
+  CHECK(borrowed.edges() == 1);
+  CHECK(std::count(counters.begin(), counters.end(), 1) == 1);
+  CHECK_THROWS_AS(CoverageMap(counters.data(), 1000), std::invalid_argument);
+
+  unsetenv("__AFL_SHM_ID");
+  CHECK(CoverageMap::fromAFLEnvironment() == nullptr);
+
+  int id = shmget(IPC_PRIVATE, CoverageMap::DEFAULT_SIZE, IPC_CREAT | 0600);
+  REQUIRE(id >= 0);
+  setenv("__AFL_SHM_ID", std::to_string(id).c_str(), 1);
+  {
+    auto shared = CoverageMap::fromAFLEnvironment();
+    REQUIRE(shared != nullptr);
+    shared->edge(0x8000, 0x8010);
+    CHECK(shared->edges() == 1);
+  }
+  // The parent process sees the hit
+  auto *parent = static_cast<uint8_t *>(shmat(id, nullptr, 0));
+  CHECK(std::count(parent, parent + CoverageMap::DEFAULT_SIZE, 1) == 1);
+  shmdt(parent);
+  shmctl(id, IPC_RMID, nullptr);
+  unsetenv("__AFL_SHM_ID");
+}
@@ -0,0 +1,136 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "FileLoader.h"
+#include "NES.h"
+#include "doctest.h"
+
+namespace {
+
+std::filesystem::path directory() {
+  auto path = std::filesystem::temp_directory_path() / "coro_nes_file_loader";
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+std::string writeFile(const std::string &name, const std::vector<uint8_t> &data) {
+  auto path = directory() / name;
+  std::ofstream file(path, std::ios_base::binary);
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  return path.string();
+}
+
+// NROM-128 spinning on JMP $8000
+std::vector<uint8_t> loopImage(uint8_t fill) {
+  std::vector<uint8_t> image(0x10 + 0x4000 + 0x2000, fill);
+  std::vector<uint8_t> header{'N', 'E', 'S', 0x1A, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  std::copy(header.begin(), header.end(), image.begin());
+  image[0x10] = 0x4C;
+  image[0x11] = 0x00;
+  image[0x12] = 0x80;
+  image[0x10 + 0x3FFC] = 0x00;
+  image[0x10 + 0x3FFD] = 0x80;
+  return image;
+}
+
+} // namespace
+
+TEST_CASE("Files come back whole, in any order") {
+  std::vector<std::vector<uint8_t>> contents;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < 40; i++) {
+    std::vector<uint8_t> data((i * 7919) % 70000);
+    for (std::size_t j = 0; j < data.size(); j++) {
+      data[j] = static_cast<uint8_t>(j * 31 + i);
+    }
+    paths.push_back(writeFile("file" + std::to_string(i), data));
+    contents.push_back(std::move(data));
+  }
+
+  // Fewer slots than files, submit has to reap
+  FileLoader loader(4);
+  std::vector<std::size_t> tickets;
+  for (const auto &path : paths) {
+    tickets.push_back(loader.submit(path));
+  }
+  std::size_t missing = loader.submit((directory() / "missing").string());
+  loader.flush();
+
+  for (std::size_t i = paths.size(); i-- > 0;) {
+    CHECK(loader.wait(tickets[i]) == contents[i]);
+  }
+  CHECK_THROWS_AS(loader.wait(missing), std::runtime_error);
+  CHECK_THROWS_AS(loader.wait(tickets[0]), std::runtime_error);
+  CHECK_THROWS_AS(loader.wait(1000), std::runtime_error);
+}
+
+TEST_CASE("Open files stay bounded by the queue depth") {
+  rlimit saved{};
+  REQUIRE(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+  rlimit low = saved;
+  low.rlim_cur = 64;
+  REQUIRE(setrlimit(RLIMIT_NOFILE, &low) == 0);
+
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < 3 * low.rlim_cur; i++) {
+    paths.push_back(writeFile("many" + std::to_string(i), {static_cast<uint8_t>(i), 1, 2, 3}));
+  }
+  {
+    FileLoader loader(16);
+    std::vector<std::size_t> tickets;
+    for (const auto &path : paths) {
+      tickets.push_back(loader.submit(path));
+    }
+    loader.flush();
+    for (std::size_t i = 0; i < tickets.size(); i++) {
+      CHECK(loader.wait(tickets[i]) == std::vector<uint8_t>{static_cast<uint8_t>(i), 1, 2, 3});
+    }
+  }
+  setrlimit(RLIMIT_NOFILE, &saved);
+}
+
+TEST_CASE("Unwaited reads are drained on destruction") {
+  auto path = writeFile("large", std::vector<uint8_t>(1 << 20, 0x5A));
+  for (int i = 0; i < 8; i++) {
+    FileLoader loader;
+    loader.submit(path);
+    loader.submit(path);
+    loader.flush();
+  }
+}
+
+TEST_CASE("Machines are built from ROM and state files") {
+  auto first = writeFile("first.nes", loopImage(0x00));
+  auto second = writeFile("second.nes", loopImage(0x01));
+
+  auto machines = NES::fromFiles({first, second});
+  REQUIRE(machines.size() == 2);
+  CHECK(machines[0]->getMapper().readPRG(0x8010) == 0x00);
+  CHECK(machines[1]->getMapper().readPRG(0x8010) == 0x01);
+
+  auto &nes = *machines[1];
+  nes.reset();
+  nes.runFrame();
+  nes.runFrame();
+  std::vector<uint8_t> state;
+  nes.saveState(state);
+  auto state_file = writeFile("second.state", state);
+
+  auto restored = NES::fromFiles({first, second, second}, {"", state_file});
+  REQUIRE(restored.size() == 3);
+  std::vector<uint8_t> loaded;
+  restored[1]->saveState(loaded);
+  CHECK(loaded == state);
+  CHECK(restored[1]->fingerprint() == nes.fingerprint());
+
+  CHECK_THROWS_AS(NES::fromFiles({first, (directory() / "missing.nes").string()}), std::runtime_error);
+  std::filesystem::remove_all(directory());
+}
@@ -0,0 +1,106 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "FuzzHarness.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+#include "mappers/DummyMapper.h"
+
+namespace {
+
+// Throws on writes to $5000, like a mapper hitting an emulator bug
+class FaultyMapper : public DummyMapper {
+public:
+  void writePRG(uint16_t address, uint8_t value) {
+    if (address == 0x5000) {
+      throw std::runtime_error("mapper fault");
+    }
+    DummyMapper::writePRG(address, value);
+  }
+};
+
+} // namespace
+
+TEST_CASE("Fuzz cases all start from the boot snapshot") {
+  auto nes = TestFixture::setupJoypadTest().nes;
+  FuzzHarness harness(nes, FuzzHarness::Options{1, 600, false});
+  std::vector<uint8_t> boot;
+  nes->saveState(boot);
+
+  const uint8_t presses[] = {Controller::A, Controller::A, 0, Controller::A};
+  for (int i = 0; i < 3; i++) {
+    FuzzHarness::Result result = harness.run(presses, sizeof(presses));
+    CHECK(result.outcome == FuzzHarness::Outcome::Ok);
+    CHECK(result.steps == 4);
+    CHECK(nes->getBus().readByte(0x0300) == 3);
+  }
+
+  // Long cases are cut
+  std::vector<uint8_t> hold(1000, Controller::A);
+  CHECK(harness.run(hold.data(), hold.size()).steps == 600);
+
+  // An empty case leaves the machine as booted
+  harness.run(nullptr, 0);
+  std::vector<uint8_t> state;
+  nes->saveState(state);
+  CHECK(state == boot);
+  CHECK(harness.executions() == 5);
+}
+
+TEST_CASE("Fuzz inputs can be held for less than a frame") {
+  auto nes = TestFixture::setupJoypadTest().nes;
+  FuzzHarness::Options options{1, 600, false};
+  options.step_scanlines = 100;
+  FuzzHarness harness(nes, options);
+
+  // NMIs read the controller every 262 scanlines: during inputs 0, 2, 5
+  // and 7
+  const uint8_t presses[] = {Controller::A, 0, Controller::A, 0, 0, Controller::A, 0, Controller::A};
+  FuzzHarness::Result result = harness.run(presses, sizeof(presses));
+  CHECK(result.outcome == FuzzHarness::Outcome::Ok);
+  CHECK(result.steps == 8);
+  CHECK(nes->getBus().readByte(0x0300) == 4);
+  CHECK(nes->getBus().getPPU().frame() == 4);
+}
+
+TEST_CASE("Fuzz cases report JAM opcodes and exceptions") {
+  SUBCASE("JAM") {
+    // Jumps to a JAM opcode once A was pressed twice
+    auto nes = TestFixture::setupJoypadTest({"CMP #$02", "BNE %00000011", "JMP $0A00"}).nes;
+    nes->getBus().writeByte(0x0A00, 0x02);
+    FuzzHarness harness(nes, FuzzHarness::Options{});
+
+    const uint8_t presses[] = {Controller::A, Controller::A, Controller::A, Controller::A};
+    FuzzHarness::Result result = harness.run(presses, sizeof(presses));
+    CHECK(result.outcome == FuzzHarness::Outcome::Jam);
+    CHECK(result.pc == 0x0A00);
+    CHECK(result.steps < 4);
+    CHECK(nes->getCPU().jammed());
+
+    // Pending NMIs do not unjam the CPU
+    CHECK(nes->getCPU().runUntil(nes->getCPU().getCycles() + 100).reason ==
+          CPU_6502::StopReason::Jam);
+
+    const uint8_t idle[] = {0, 0, 0, 0};
+    CHECK(harness.run(idle, sizeof(idle)).outcome == FuzzHarness::Outcome::Ok);
+    CHECK_FALSE(nes->getCPU().jammed());
+  }
+
+  SUBCASE("Exception") {
+    auto nes =
+        TestFixture::setupJoypadTest({"CMP #$02", "BNE %00000011", "STA $5000"}, std::make_unique<FaultyMapper>()).nes;
+    FuzzHarness harness(nes, FuzzHarness::Options{});
+    const uint8_t presses[] = {Controller::A, Controller::A, Controller::A, Controller::A};
+    FuzzHarness::Result result = harness.run(presses, sizeof(presses));
+    CHECK(result.outcome == FuzzHarness::Outcome::Exception);
+    CHECK(result.message == "mapper fault");
+
+    const uint8_t idle[] = {0, 0};
+    CHECK(harness.run(idle, sizeof(idle)).outcome == FuzzHarness::Outcome::Ok);
+  }
+}
@@ -0,0 +1,187 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+namespace {
+
+// Solid tile 1 on the first nametable row, sprite 0 over it on line 1 and
+// nine sprites sharing lines 100 - 107
+void setupScene(Bus &bus, uint8_t ctrl = 0x00) {
+  bus.writeByte(0x2006, 0x00);
+  bus.writeByte(0x2006, 0x10);
+  for (int i = 0; i < 16; i++) {
+    bus.writeByte(0x2007, i < 8 ? 0xFF : 0x00);
+  }
+
+  bus.writeByte(0x2006, 0x20);
+  bus.writeByte(0x2006, 0x00);
+  for (int i = 0; i < 32; i++) {
+    bus.writeByte(0x2007, 0x01);
+  }
+
+  bus.writeByte(0x2006, 0x3F);
+  bus.writeByte(0x2006, 0x00);
+  bus.writeByte(0x2007, 0x0F); // Backdrop
+  bus.writeByte(0x2007, 0x21); // Background colour 1
+  bus.writeByte(0x2006, 0x3F);
+  bus.writeByte(0x2006, 0x11);
+  bus.writeByte(0x2007, 0x16); // Sprite colour 1
+
+  bus.writeByte(0x2003, 0x00);
+  for (int i = 0; i < 64; i++) {
+    uint8_t y = i == 0 ? 0x00 : i < 10 ? 99 : 0xFF;
+    bus.writeByte(0x2004, y);
+    bus.writeByte(0x2004, 0x01);
+    bus.writeByte(0x2004, 0x00);
+    bus.writeByte(0x2004, i == 0 ? 40 : i * 10);
+  }
+
+  bus.writeByte(0x2000, ctrl);
+  bus.writeByte(0x2005, 0x00);
+  bus.writeByte(0x2005, 0x00);
+  bus.writeByte(0x2001, 0x1E);
+}
+
+class CountingMapper : public DummyMapper {
+public:
+  void ppuA12Rise() override { rises++; }
+  int rises = 0;
+};
+
+} // namespace
+
+TEST_CASE("Vblank sets PPUSTATUS and fires NMI once per frame") {
+  auto fixture = TestFixture::setupTest({
+      "JMP $0800", // $800
+      "INC $20",   // $803, NMI handler
+      "RTI",
+  });
+  fixture.bus->writeByte(0xFFFA, 0x03);
+  fixture.bus->writeByte(0xFFFB, 0x08);
+  fixture.cpu->reset(); // Vectors are latched on reset
+  fixture.bus->writeByte(0x2000, 0x80);
+
+  auto &ppu = fixture.bus->getPPU();
+  for (int i = 1; i <= 5; i++) {
+    fixture.nes->runFrame();
+    CHECK(ppu.frame() == i);
+  }
+  // Frames end as vblank starts, the last NMI is still pending
+  CHECK(fixture.bus->readByte(0x20) == 4);
+  CHECK(fixture.bus->interrupts().nmi());
+  CHECK((fixture.bus->readByte(0x2002) & 0x80) != 0);
+  CHECK((fixture.bus->readByte(0x2002) & 0x80) == 0);
+}
+
+TEST_CASE("Render skip keeps sprite 0 hit and overflow but no pixels") {
+  std::vector<std::string> program = {
+      "BIT $2002",      // $800, wait for vblank
+      "BPL %11111011",
+      "BIT $2002",      // $805, wait for the pre-render line
+      "BVS %11111011",
+      "BIT $2002",      // $80A, wait for sprite 0 hit
+      "BVC %11111011",
+      "JMP $080F",      // $80F
+  };
+
+  auto run = [&](bool render) {
+    auto fixture = TestFixture::setupTest(program);
+    setupScene(*fixture.bus);
+    fixture.nes->setFrameOptions({0, 1, render});
+    CHECK(fixture.nes->runFrame() == render);
+
+    auto stop = fixture.nes->runUntil(
+        fixture.nes->masterClock() + 2 * NES::MASTER_CYCLES_PER_FRAME,
+        [](const CPU_6502 &cpu) { return cpu.dumpRegisters().PC == 0x080F; });
+    CHECK(stop.reason == CPU_6502::StopReason::Predicate);
+    return fixture;
+  };
+
+  auto rendered = run(true);
+  auto skipped = run(false);
+
+  // The CPU saw sprite 0 hit at the same cycle
+  CHECK(rendered.cpu->getCycles() == skipped.cpu->getCycles());
+
+  for (auto *fixture : {&rendered, &skipped}) {
+    fixture->nes->runFrame();
+    uint8_t status = fixture->bus->readByte(0x2002);
+    CHECK((status & 0xE0) == 0xE0);
+  }
+
+  const auto &picture = rendered.bus->getPPU().getFrameBuffer();
+  CHECK(picture[1 * PPU::WIDTH + 0] == 0x21);
+  CHECK(picture[1 * PPU::WIDTH + 40] == 0x16);
+  CHECK(picture[50 * PPU::WIDTH + 0] == 0x0F);
+  CHECK(picture[100 * PPU::WIDTH + 10] == 0x16);
+
+  for (uint8_t pixel : skipped.bus->getPPU().getFrameBuffer()) {
+    REQUIRE(pixel == 0);
+  }
+}
+
+TEST_CASE("MMC3 A12 clocks are kept in render skip mode") {
+  auto owned = std::make_unique<CountingMapper>();
+  auto *mapper = owned.get();
+  NES nes(std::move(owned));
+  nes.getBus().writeByte(0x8000, 0x4C); // JMP $8000
+  nes.getBus().writeByte(0x8001, 0x00);
+  nes.getBus().writeByte(0x8002, 0x80);
+  nes.getBus().writeByte(0xFFFC, 0x00);
+  nes.getBus().writeByte(0xFFFD, 0x80);
+  nes.reset();
+
+  // Background at $0000, sprites at $1000
+  setupScene(nes.getBus(), 0x08);
+  nes.runFrame();
+
+  for (bool render : {true, false}) {
+    nes.setFrameOptions({0, 1, render});
+    mapper->rises = 0;
+    nes.runFrame();
+    // 240 visible lines and the pre-render line
+    CHECK(mapper->rises == 241);
+  }
+}
+
+TEST_CASE("Frame skip and action repeat") {
+  auto fixture = TestFixture::setupTest({"JMP $0800"});
+  auto &nes = *fixture.nes;
+
+  SUBCASE("Every other frame is rendered") {
+    nes.setFrameOptions({1, 1, true});
+    CHECK_FALSE(nes.runFrame());
+    CHECK(nes.runFrame());
+    CHECK_FALSE(nes.runFrame());
+    CHECK(nes.runFrame());
+  }
+
+  SUBCASE("Only the last repeated frame is rendered") {
+    nes.setFrameOptions({3, 4, true});
+    uint64_t frame = fixture.bus->getPPU().frame();
+    CHECK(nes.step(Controller::START | Controller::A));
+    CHECK(fixture.bus->getPPU().frame() == frame + 4);
+    CHECK(nes.step(0));
+  }
+
+  SUBCASE("Rendering off") {
+    nes.setFrameOptions({0, 2, false});
+    CHECK_FALSE(nes.step(0));
+    CHECK_FALSE(nes.runFrame());
+  }
+
+  SUBCASE("Buttons are read serially from $4016") {
+    nes.step(Controller::START | Controller::RIGHT);
+    fixture.bus->writeByte(0x4016, 0x01);
+    fixture.bus->writeByte(0x4016, 0x00);
+    uint8_t buttons = 0;
+    for (int i = 0; i < 8; i++) {
+      buttons |= (fixture.bus->readByte(0x4016) & 0x01) << i;
+    }
+    CHECK(buttons == (Controller::START | Controller::RIGHT));
+    CHECK((fixture.bus->readByte(0x4016) & 0x01) == 1);
+  }
+}
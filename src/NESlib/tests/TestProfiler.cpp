@@ -0,0 +1,186 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "Profiler.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+TEST_CASE("Profiler counts executions and cycles per PC and opcode") {
+  auto fixture = TestFixture::setupTest({
+      "LDX #$03",
+      "DEX",      // $802
+      "BNE %11111101", // $803, back to DEX
+      "NOP",
+  });
+  Profiler profiler;
+  fixture.cpu->attachProfiler(&profiler);
+  fixture.cpu->step(1 + 3 * 2 + 1);
+
+  CHECK(profiler.get(0, 0x800).count == 1);
+  CHECK(profiler.get(0, 0x802).count == 3);
+  CHECK(profiler.get(0, 0x803).count == 3);
+  CHECK(profiler.get(0, 0x805).count == 1);
+  // Two taken branches (3 cycles) and one not taken (2 cycles)
+  CHECK(profiler.get(0, 0x803).cycles == 3 + 3 + 2);
+  CHECK(profiler.getOpcodes()[0xCA].count == 3);
+  CHECK(profiler.totalCycles() == 2 + 3 * 2 + 8 + 2);
+
+  SUBCASE("Machine-readable dump") {
+    std::ostringstream dump;
+    profiler.dump(dump);
+    CHECK(dump.str().find("pc,0,2051,3,8\n") != std::string::npos);
+  }
+
+  SUBCASE("Detached profiler no longer counts") {
+    fixture.cpu->attachProfiler(nullptr);
+    fixture.cpu->step();
+    CHECK(profiler.totalCycles() == 18);
+  }
+}
+
+TEST_CASE("Profiler counts rewritten code under the opcode executed") {
+  auto fixture = TestFixture::setupTest({
+      "NOP",       // $800, rewritten to INX
+      "LDA #$E8",  // $801
+      "STA $0800", // $803
+      "JMP $0800", // $806
+  });
+  Profiler profiler;
+  fixture.cpu->attachProfiler(&profiler);
+  fixture.cpu->step(8);
+
+  CHECK(profiler.get(0, 0x800).count == 2);
+  auto opcodes = profiler.getOpcodes();
+  CHECK(opcodes[0xEA].count == 1);
+  CHECK(opcodes[0xE8].count == 1);
+  CHECK(opcodes[0xE8].cycles == 2);
+  CHECK(opcodes[0xA9].count == 2);
+  CHECK(profiler.totalCycles() == 2 * (2 + 2 + 4 + 3));
+
+  std::ostringstream dump;
+  profiler.dump(dump);
+  CHECK(dump.str().find("opcode,,234,1,2\n") != std::string::npos);
+  CHECK(dump.str().find("opcode,,232,1,2\n") != std::string::npos);
+}
+
+TEST_CASE("Profiler follows bank switches") {
+  // $5000 selects the bank mapped at $8000 - $FFFF
+  class BankedMapper : public DummyMapper {
+  public:
+    void writePRG(uint16_t address, uint8_t value) override {
+      if (address == 0x5000) {
+        bank = value;
+      }
+      DummyMapper::writePRG(address, value);
+    }
+    uint16_t prgBank(uint16_t address) override { return address >= 0x8000 ? bank : 0; }
+    uint8_t bank = 0;
+  };
+  auto nes = std::make_shared<NES>(std::make_unique<BankedMapper>());
+  Bus &bus = nes->getBus();
+  const uint8_t code[] = {
+      0xA9, 0x01,       // $8000 LDA #$01
+      0x8D, 0x00, 0x50, // $8002 STA $5000
+      0x4C, 0x00, 0x80, // $8005 JMP $8000
+  };
+  for (uint16_t i = 0; i < sizeof(code); i++) {
+    bus.writeByte(0x8000 + i, code[i]);
+  }
+  bus.writeByte(0xFFFC, 0x00);
+  bus.writeByte(0xFFFD, 0x80);
+  nes->getCPU().reset();
+
+  Profiler profiler;
+  nes->getCPU().attachProfiler(&profiler);
+  nes->getCPU().step(6);
+
+  CHECK(profiler.get(0, 0x8000).count == 1);
+  CHECK(profiler.get(0, 0x8002).count == 1);
+  CHECK(profiler.get(0, 0x8005).count == 0);
+  CHECK(profiler.get(1, 0x8005).count == 2);
+  CHECK(profiler.get(1, 0x8000).count == 1);
+  CHECK(profiler.get(1, 0x8002).count == 1);
+}
+
+TEST_CASE("Call graph attributes cycles to guest routines") {
+  auto fixture = TestFixture::setupTest({
+      "JSR $0807", // $800
+      "JSR $080A", // $803
+      "NOP",       // $806
+      "JSR $080A", // $807 outer
+      "RTS",       // $80A inner, also returns from outer
+  });
+  CallGraph callgraph;
+  fixture.cpu->attachCallGraph(&callgraph);
+
+  SymbolTable symbols;
+  std::istringstream listing(
+      "outer. . . . . . . . . . . . . . 0807   2055  LBL WORD  test.asm:4\n"
+      "inner 80A\n");
+  symbols.load(listing);
+
+  fixture.cpu->step(); // JSR outer
+  CHECK(callgraph.depth() == 1);
+  fixture.cpu->step(); // JSR inner
+  CHECK(callgraph.depth() == 2);
+  fixture.cpu->step(); // RTS to outer
+  CHECK(callgraph.depth() == 1);
+  fixture.cpu->step(); // RTS to main
+  CHECK(callgraph.depth() == 0);
+  fixture.cpu->step(2); // JSR inner, RTS
+  CHECK(callgraph.depth() == 0);
+
+  auto routines = callgraph.routines();
+  REQUIRE(routines.size() == 2);
+  // outer: JSR inner (6) + inner RTS (6) + its own RTS (6)
+  CHECK(routines[0].address == 0x807);
+  CHECK(routines[0].calls == 1);
+  CHECK(routines[0].inclusive == 18);
+  CHECK(routines[0].exclusive == 12);
+  CHECK(routines[1].address == 0x80A);
+  CHECK(routines[1].calls == 2);
+  CHECK(routines[1].inclusive == 12);
+
+  std::ostringstream collapsed;
+  callgraph.exportCollapsed(collapsed, symbols);
+  CHECK(collapsed.str().find("(root);outer;inner 6\n") != std::string::npos);
+  CHECK(collapsed.str().find("(root);outer 12\n") != std::string::npos);
+  CHECK(collapsed.str().find("(root);inner 6\n") != std::string::npos);
+}
+
+TEST_CASE("Call graph counts routines that have not returned yet") {
+  auto fixture = TestFixture::setupTest({
+      "JSR $0803", // $800, main never returns
+      "JSR $0809", // $803 main loop
+      "JMP $0803", // $806
+      "RTS",       // $809
+  });
+  CallGraph callgraph;
+  fixture.cpu->attachCallGraph(&callgraph);
+  fixture.cpu->step(6); // JSR main, then the loop twice
+  CHECK(callgraph.depth() == 1);
+
+  auto routines = callgraph.routines();
+  REQUIRE(routines.size() == 2);
+  CHECK(routines[0].address == 0x803);
+  CHECK(routines[0].calls == 1);
+  // JSR, JMP, JSR and both calls of the RTS routine
+  CHECK(routines[0].exclusive == 6 + 3 + 6);
+  CHECK(routines[0].inclusive == 6 + 3 + 6 + 12);
+  CHECK(routines[1].address == 0x809);
+  CHECK(routines[1].calls == 2);
+  CHECK(routines[1].inclusive == 12);
+}
+
+TEST_CASE("Call graph survives dropped return addresses") {
+  CallGraph callgraph;
+  callgraph.enter(0, 0x8000, 0xFD, 10);
+  callgraph.enter(0, 0x9000, 0xFB, 20);
+  // Callee pulls its return address and returns straight to main
+  callgraph.leave(0xFD, 40);
+  CHECK(callgraph.depth() == 0);
+}
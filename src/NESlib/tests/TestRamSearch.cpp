@@ -0,0 +1,96 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "RamSearch.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+TEST_CASE("RAM search narrows down a decreasing counter") {
+  for (bool simd : {true, false}) {
+    RamSearch search(simd);
+    std::vector<uint8_t> memory(0x800);
+    const uint8_t lives[] = {5, 4, 3};
+    const uint8_t timer[] = {9, 8, 7};
+    for (int frame = 0; frame < 3; frame++) {
+      memory[0x064] = lives[frame];
+      memory[0x0C8] = timer[frame];
+      memory[0x12C] = 3; // Constant 3
+      memory[0x700] = frame; // Increasing
+      search.snapshot(memory.data(), memory.size());
+    }
+    CHECK(search.snapshots() == 3);
+    CHECK(search.candidateCount() == 0x800);
+
+    search.compareLast(RamSearch::Compare::Less);
+    CHECK(search.candidates() == std::vector<uint16_t>{0x064, 0x0C8});
+    search.compare(RamSearch::Compare::Equal, 3);
+    CHECK(search.candidates() == std::vector<uint16_t>{0x064});
+    CHECK(search.value(0x0864) == 3); // Mirror
+
+    search.reset();
+    CHECK(search.snapshots() == 0);
+    CHECK(search.candidateCount() == 0);
+  }
+}
+
+TEST_CASE("SIMD and portable filters agree") {
+  std::mt19937 random(1234);
+  // Not a multiple of the vector width, to cover the tail
+  constexpr std::size_t SIZE = 0x800 + 0x2000 - 5;
+  std::vector<std::vector<uint8_t>> snapshots(40, std::vector<uint8_t>(SIZE));
+  for (auto &snapshot : snapshots) {
+    for (uint8_t &byte : snapshot) {
+      byte = random() % 4; // Small values, so every comparison sees ties
+    }
+  }
+
+  using Compare = RamSearch::Compare;
+  for (Compare op : {Compare::Equal, Compare::NotEqual, Compare::Less, Compare::Greater,
+                     Compare::LessEqual, Compare::GreaterEqual}) {
+    RamSearch simd(true);
+    RamSearch portable(false);
+    for (const auto &snapshot : snapshots) {
+      simd.snapshot(snapshot.data(), SIZE);
+      portable.snapshot(snapshot.data(), SIZE);
+    }
+    simd.compareLast(op);
+    portable.compareLast(op);
+    CHECK(simd.candidates() == portable.candidates());
+    simd.compare(op, 2);
+    portable.compare(op, 2);
+    CHECK(simd.candidates() == portable.candidates());
+
+    simd.reset();
+    portable.reset();
+    for (int i = 0; i < 3; i++) {
+      simd.snapshot(snapshots[i].data(), SIZE);
+      portable.snapshot(snapshots[i].data(), SIZE);
+    }
+    simd.compareAll(op);
+    portable.compareAll(op);
+    CHECK(simd.candidates() == portable.candidates());
+    CHECK(simd.candidateCount() == portable.candidateCount());
+  }
+}
+
+TEST_CASE("RAM search snapshots the machine RAM") {
+  auto fixture = TestFixture::setupTest({"JMP $0800"});
+  RamSearch search;
+  fixture.bus->writeByte(0x0123, 7);
+  search.snapshot(*fixture.nes);
+  fixture.bus->writeByte(0x0123, 6);
+  search.snapshot(*fixture.nes);
+
+  search.compareLast(RamSearch::Compare::Less);
+  CHECK(search.candidates() == std::vector<uint16_t>{0x0123});
+  CHECK(search.value(0x0123) == 6);
+  // No PRG RAM on this board
+  CHECK_THROWS_AS(search.value(0x6000), std::out_of_range);
+
+  std::vector<uint8_t> shorter(0x400);
+  CHECK_THROWS_AS(search.snapshot(shorter.data(), shorter.size()), std::runtime_error);
+}
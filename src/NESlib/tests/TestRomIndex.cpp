@@ -0,0 +1,119 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "RomIndex.h"
+#include "doctest.h"
+
+namespace {
+
+std::vector<uint8_t> makeImage(std::vector<uint8_t> header, uint8_t fill) {
+  header.resize(CartridgeHeader::size, 0);
+  std::size_t payload = ((header[6] & 0x04) ? CartridgeHeader::trainer_size : 0) + header[4] * 0x4000 +
+                        header[5] * 0x2000;
+  header.resize(CartridgeHeader::size + payload, fill);
+  return header;
+}
+
+void writeFile(const std::filesystem::path &path, const std::vector<uint8_t> &data) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream file(path, std::ios_base::binary);
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+} // namespace
+
+TEST_CASE("CRC-32 matches zlib on both paths") {
+  CHECK(crc32("", 0) == 0);
+  CHECK(crc32("123456789", 9) == 0xCBF43926);
+  CHECK(crc32Portable("123456789", 9) == 0xCBF43926);
+  CHECK(crc32("6789", 4, crc32("12345", 5)) == 0xCBF43926);
+
+  std::mt19937 random(7);
+  std::vector<uint8_t> data(5000);
+  for (auto &byte : data) {
+    byte = static_cast<uint8_t>(random());
+  }
+  for (std::size_t size : {63, 64, 65, 79, 80, 127, 128, 200, 1024, 4999}) {
+    for (std::size_t offset : {0, 1, 3}) {
+      CHECK(crc32(data.data() + offset, size) == crc32Portable(data.data() + offset, size));
+      CHECK(crc32(data.data() + offset, size, 0x1234) == crc32Portable(data.data() + offset, size, 0x1234));
+    }
+  }
+}
+
+TEST_CASE("ROMs are identified by content, not header") {
+  auto image = makeImage({'N', 'E', 'S', 0x1A, 1, 1}, 0x42);
+  auto relabeled = makeImage({'N', 'E', 'S', 0x1A, 1, 1, 0x14}, 0x42); // Mapper 1, trainer
+  auto other = makeImage({'N', 'E', 'S', 0x1A, 1, 1}, 0x43);
+
+  auto a = RomIndex::identify(image);
+  auto b = RomIndex::identify(relabeled);
+  CHECK(a.hash == b.hash);
+  CHECK(a.crc == b.crc);
+  CHECK(a.crc == crc32(image.data() + 0x10, 0x6000));
+  CHECK(b.header.mapper == 1);
+  CHECK(RomIndex::identify(other).hash != a.hash);
+
+  Cartridge cartridge{std::span<const uint8_t>(image)};
+  auto c = RomIndex::identify(cartridge);
+  CHECK(c.hash == a.hash);
+  CHECK(c.crc == a.crc);
+
+  image.resize(0x100);
+  CHECK_THROWS_AS(RomIndex::identify(image), CartridgeError);
+}
+
+TEST_CASE("Library scans are saved, loaded and searched") {
+  auto root = std::filesystem::temp_directory_path() / "coro_nes_rom_index";
+  std::filesystem::remove_all(root);
+  auto nrom = makeImage({'N', 'E', 'S', 0x1A, 2, 1, 0x01}, 0x11);
+  writeFile(root / "a" / "game.nes", nrom);
+  writeFile(root / "b" / "copy.NES", nrom);
+  writeFile(root / "b" / "c" / "other.nes", makeImage({'N', 'E', 'S', 0x1A, 1, 0, 0x02, 0x08, 0, 0}, 0x22));
+  writeFile(root / "broken.nes", {'N', 'E', 'S', 0x1A, 4});
+  writeFile(root / "notes.txt", {'h', 'i'});
+
+  RomIndex::ScanStats stats;
+  RomIndex index = RomIndex::scan(root, 3, &stats);
+  CHECK(stats.files == 4);
+  CHECK(stats.skipped == 1);
+  REQUIRE(index.size() == 3);
+
+  std::stringstream file;
+  index.save(file);
+  RomIndex loaded = RomIndex::load(file);
+  REQUIRE(loaded.size() == 3);
+
+  auto key = RomIndex::identify(nrom);
+  auto copies = loaded.find(key.hash);
+  REQUIRE(copies.size() == 2);
+  CHECK(copies[0].path == "a/game.nes");
+  CHECK(copies[1].path == "b/copy.NES");
+  CHECK(copies[0].crc == key.crc);
+  CHECK(copies[0].header.mirroring == Mirroring::Vertical);
+  CHECK(copies[0].header.prg_rom_size == 0x8000);
+  CHECK(loaded.findCRC(key.crc).size() == 2);
+
+  for (std::size_t i = 0; i < index.size(); i++) {
+    const auto &x = index.entries()[i];
+    const auto &y = loaded.entries()[i];
+    CHECK(x.hash == y.hash);
+    CHECK(x.path == y.path);
+    CHECK(x.header.battery == y.header.battery);
+    CHECK(x.header.nes2 == y.header.nes2);
+    CHECK(x.header.chr_ram_size == y.header.chr_ram_size);
+  }
+  CHECK(loaded.find(key.hash ^ 1).empty());
+
+  std::stringstream garbage("NESROMIX");
+  CHECK_THROWS_AS(RomIndex::load(garbage), std::runtime_error);
+  std::filesystem::remove_all(root);
+}
@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <vector>
+
+#include "Scheduler.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+enum flags { N_f, V_f, B_f, D_f, I_f, Z_f, C_f };
+
+TEST_CASE("Scheduler dispatches events in timestamp order") {
+  Scheduler scheduler;
+  std::vector<EventType> fired;
+  for (auto type : {EventType::PPU, EventType::APU_FRAME_IRQ,
+                    EventType::MAPPER_IRQ}) {
+    scheduler.setHandler(type, [&fired, type](uint64_t) { fired.push_back(type); });
+  }
+
+  scheduler.schedule(EventType::PPU, 300);
+  scheduler.schedule(EventType::APU_FRAME_IRQ, 100);
+  scheduler.schedule(EventType::MAPPER_IRQ, 200);
+  CHECK(scheduler.nextDeadline() == 100);
+
+  SUBCASE("Only due events run") {
+    scheduler.dispatch(250);
+    CHECK(fired == std::vector{EventType::APU_FRAME_IRQ, EventType::MAPPER_IRQ});
+    CHECK(scheduler.nextDeadline() == 300);
+  }
+
+  SUBCASE("Rescheduling moves the deadline") {
+    scheduler.schedule(EventType::APU_FRAME_IRQ, 400);
+    CHECK(scheduler.nextDeadline() == 200);
+    scheduler.dispatch(1000);
+    CHECK(fired == std::vector{EventType::MAPPER_IRQ, EventType::PPU,
+                               EventType::APU_FRAME_IRQ});
+  }
+
+  SUBCASE("Cancelled events never fire") {
+    scheduler.cancel(EventType::MAPPER_IRQ);
+    CHECK_FALSE(scheduler.isScheduled(EventType::MAPPER_IRQ));
+    scheduler.dispatch(1000);
+    CHECK(fired.size() == 2);
+    CHECK(scheduler.nextDeadline() == Scheduler::NEVER);
+  }
+}
+
+TEST_CASE("The CPU runs freely until the earliest deadline") {
+  // Tight loop: 3 cycles per JMP
+  auto fixture = TestFixture::setupTest({"JMP $0800"});
+  auto &scheduler = fixture.nes->getScheduler();
+  uint64_t firedAt = 0;
+  uint64_t cpuCycleAtFire = 0;
+  scheduler.setHandler(EventType::MAPPER_IRQ, [&](uint64_t timestamp) {
+    firedAt = timestamp;
+    cpuCycleAtFire = fixture.cpu->getCycles();
+    fixture.bus->interrupts().setIRQ(InterruptLines::IRQ_MAPPER, true);
+  });
+
+  uint64_t start = fixture.nes->masterClock();
+  scheduler.schedule(EventType::MAPPER_IRQ, start + 100 * Scheduler::CPU_DIVIDER);
+  fixture.nes->runUntil(start + 1000 * Scheduler::CPU_DIVIDER);
+
+  CHECK(firedAt == start + 100 * Scheduler::CPU_DIVIDER);
+  // Instructions are atomic, the event is seen at most one instruction late
+  CHECK(cpuCycleAtFire * Scheduler::CPU_DIVIDER >= firedAt);
+  CHECK(cpuCycleAtFire * Scheduler::CPU_DIVIDER < firedAt + 3 * Scheduler::CPU_DIVIDER);
+  CHECK(fixture.nes->masterClock() >= start + 1000 * Scheduler::CPU_DIVIDER);
+  // The IRQ raised by the event was serviced
+  CHECK(fixture.cpu->dumpRegisters().flags[I_f]);
+}
+
+TEST_CASE("Idle loops are fast-forwarded to the next event") {
+  // Polls $10 until an event sets it, then polls PPUSTATUS, then spins
+  std::vector<std::string> program = {
+      "LDA $10",     // $800
+      "BEQ %11111100", // $802, back to $800
+      "LDX #$05",    // $804
+      "BIT $2002",   // $806
+      "BPL %11111011", // $809, back to $806
+  };
+
+  auto run = [&](bool skipping) {
+    auto fixture = TestFixture::setupTest(program);
+    fixture.cpu->setIdleLoopSkipping(skipping);
+    auto &scheduler = fixture.nes->getScheduler();
+    scheduler.setHandler(EventType::MAPPER_IRQ,
+                         [&](uint64_t) { fixture.bus->writeByte(0x10, 0x01); });
+    uint64_t start = fixture.nes->masterClock();
+    scheduler.schedule(EventType::MAPPER_IRQ, start + 10007 * Scheduler::CPU_DIVIDER);
+    fixture.nes->runUntil(start + 20000 * Scheduler::CPU_DIVIDER);
+    return fixture;
+  };
+
+  auto plain = run(false);
+  auto skipped = run(true);
+
+  CHECK(plain.cpu->getIdleSkippedCycles() == 0);
+  CHECK(skipped.cpu->getIdleSkippedCycles() > 15000);
+  CHECK(skipped.cpu->getCycles() == plain.cpu->getCycles());
+  auto a = plain.cpu->dumpRegisters();
+  auto b = skipped.cpu->dumpRegisters();
+  CHECK(a.PC == b.PC);
+  CHECK(a.X == 0x05);
+  CHECK(b.X == 0x05);
+  CHECK(a.flags == b.flags);
+}
+
+TEST_CASE("Loops with side effects are not skipped") {
+  auto fixture = TestFixture::setupTest({
+      "INC $10",     // $800
+      "JMP $0800",
+  });
+  fixture.nes->runUntil(fixture.nes->masterClock() + 1000 * Scheduler::CPU_DIVIDER);
+  CHECK(fixture.cpu->getIdleSkippedCycles() == 0);
+  CHECK(fixture.bus->readByte(0x10) != 0);
+}
@@ -0,0 +1,248 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <atomic>
+#include <stdexcept>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "InputSearch.h"
+#include "PagedState.h"
+#include "StateHash.h"
+#include "TranspositionTable.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+namespace {
+
+// Each NMI adds A and subtracts B from $0300
+TestFixture::NES_Test joypadGame() {
+  return TestFixture::setupJoypadTest({
+      "LDA $4016", "AND #$01", "STA $0301", "LDA $0300", "SEC", "SBC $0301", "STA $0300", // B
+  });
+}
+
+} // namespace
+
+TEST_CASE("Transposition table keeps the earliest depth of each state") {
+  TranspositionTable table(1000);
+  CHECK(table.capacity() == 1024);
+  CHECK(table.count() == 0);
+
+  uint32_t depth = 0;
+  CHECK_FALSE(table.lookup(42, 7, depth));
+  CHECK(table.insert(42, 7, 10));
+  CHECK(table.lookup(42, 7, depth));
+  CHECK(depth == 10);
+
+  // Reached again, no earlier
+  CHECK_FALSE(table.insert(42, 7, 10));
+  CHECK_FALSE(table.insert(42, 7, 12));
+  // Reached earlier, worth expanding again
+  CHECK(table.insert(42, 7, 4));
+  CHECK(table.lookup(42, 7, depth));
+  CHECK(depth == 4);
+
+  // Same fingerprint, another digest: a collision, not a duplicate
+  CHECK(table.insert(42, 8, 20));
+  CHECK_FALSE(table.lookup(42, 9, depth));
+  CHECK(table.count() == 2);
+
+  // Fingerprint 0 is a valid state too
+  CHECK(table.insert(0, 0, 0));
+  CHECK_FALSE(table.insert(0, 0, 0));
+
+  table.clear();
+  CHECK(table.count() == 0);
+}
+
+TEST_CASE("Full buckets drop their deepest entries") {
+  TranspositionTable table(4); // A single bucket
+  for (uint32_t i = 0; i < 4; i++) {
+    CHECK(table.insert(i + 1, 0, 10 + i));
+  }
+  CHECK(table.insert(100, 0, 1));
+  uint32_t depth;
+  CHECK_FALSE(table.lookup(4, 0, depth));
+  for (uint64_t key : {1, 2, 3, 100}) {
+    CHECK(table.lookup(key, 0, depth));
+  }
+}
+
+TEST_CASE("Identical machines reached through different writes are duplicates") {
+  auto fixture = TestFixture::setupTest({
+      "INC $0210",   // $800
+      "JMP $0800",
+  });
+  auto &nes = *fixture.nes;
+  nes.runFrame();
+  PagedState root;
+  root.capture(nes);
+
+  TranspositionTable table(1 << 10);
+  auto visit = [&](uint32_t depth) {
+    return table.insert(nes.fingerprint(), TranspositionTable::digest(nes), depth);
+  };
+
+  // Two branches write the same byte in different orders
+  root.restore(nes);
+  fixture.bus->writeByte(0x0300, 1);
+  fixture.bus->writeByte(0x0300, 2);
+  nes.runFrame();
+  CHECK(visit(1));
+
+  root.restore(nes);
+  fixture.bus->writeByte(0x0300, 2);
+  nes.runFrame();
+  CHECK_FALSE(visit(1));
+
+  root.restore(nes);
+  fixture.bus->writeByte(0x0300, 3);
+  nes.runFrame();
+  CHECK(visit(1));
+}
+
+TEST_CASE("Workers share the transposition table") {
+  constexpr int WORKERS = 4;
+  constexpr uint64_t KEYS = 4000;
+  TranspositionTable table(1 << 18);
+  std::atomic<uint64_t> inserted{0};
+
+  std::vector<std::thread> workers;
+  for (int w = 0; w < WORKERS; w++) {
+    workers.emplace_back([&, w] {
+      uint64_t mine = 0;
+      for (uint64_t i = 0; i < KEYS; i++) {
+        uint64_t key = hash64(&i, sizeof(i));
+        mine += table.insert(key, static_cast<uint32_t>(i), static_cast<uint32_t>(w));
+      }
+      inserted += mine;
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  // Racing inserts of one state may both succeed, but no state is lost
+  // and the earliest depth wins. The table is large enough for no bucket
+  // to overflow.
+  CHECK(inserted >= KEYS);
+  for (uint64_t i = 0; i < KEYS; i++) {
+    uint32_t depth = 1;
+    CHECK(table.lookup(hash64(&i, sizeof(i)), static_cast<uint32_t>(i), depth));
+    CHECK(depth == 0);
+  }
+}
+
+TEST_CASE("Racing inserts of one state keep its earliest depth") {
+  constexpr int WORKERS = 4;
+  TranspositionTable table(8); // Each state alone in its bucket
+  for (int round = 0; round < 500; round++) {
+    table.clear();
+    std::atomic<int> ready{0};
+    std::vector<std::thread> workers;
+    for (int w = 0; w < WORKERS; w++) {
+      workers.emplace_back([&, w] {
+        ready++;
+        while (ready < WORKERS) {
+        }
+        table.insert(0x1234, 0xABCD, static_cast<uint32_t>(WORKERS - w));
+        table.insert(0x5679, 0xABCD, static_cast<uint32_t>(w));
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    uint32_t depth = 0;
+    REQUIRE(table.lookup(0x1234, 0xABCD, depth));
+    CHECK(depth == 1);
+    REQUIRE(table.lookup(0x5679, 0xABCD, depth));
+    CHECK(depth == 0);
+    CHECK_FALSE(table.insert(0x1234, 0xABCD, 1));
+    CHECK_FALSE(table.insert(0x5679, 0xABCD, 0));
+  }
+}
+
+TEST_CASE("Input search finds the shortest sequence reaching a RAM goal") {
+  auto start = joypadGame();
+  start.nes->runFrame();
+  REQUIRE(start.bus->readByte(0x300) == 0);
+
+  InputSearch::Options options;
+  options.inputs = {0, Controller::A, Controller::B, Controller::A | Controller::B};
+  options.max_depth = 10;
+  options.beam_width = 8;
+  options.table_capacity = 1 << 12;
+
+  SUBCASE("Beam") {}
+  SUBCASE("Best first") { options.strategy = InputSearch::Strategy::BestFirst; }
+  SUBCASE("Single worker") { options.threads = 1; }
+
+  InputSearch search([] { return joypadGame().nes; }, options);
+  auto objective = [](const uint8_t *ram) { return static_cast<int8_t>(ram[0x300]); };
+  auto goal = [](const uint8_t *ram) { return ram[0x300] == 4; };
+  InputSearch::Result result = search.run(*start.nes, objective, goal);
+
+  CHECK(result.goal);
+  CHECK(result.score == 4);
+  CHECK(result.inputs == std::vector<uint8_t>(4, Controller::A));
+  // Pressing nothing, or A and B together, comes back to a known state
+  CHECK(result.duplicates > 0);
+  CHECK(start.bus->readByte(0x300) == 0);
+
+  // Replaying the inputs reaches the goal
+  for (uint8_t input : result.inputs) {
+    start.nes->step(input);
+  }
+  CHECK(start.bus->readByte(0x300) == 4);
+}
+
+TEST_CASE("Input search gives the same result on any number of workers") {
+  auto start = joypadGame();
+  start.nes->runFrame();
+
+  // Pressing A then nothing, or nothing then A, reaches the same state: the
+  // one kept decides which nodes tie for the beam, and the path found
+  InputSearch::Options options;
+  options.inputs = {0, Controller::A, Controller::B, Controller::A | Controller::B};
+  options.max_depth = 8;
+  options.beam_width = 3;
+  options.table_capacity = 1 << 12;
+  auto search = [&](unsigned threads) {
+    options.threads = threads;
+    InputSearch search([] { return joypadGame().nes; }, options);
+    return search.run(
+        *start.nes, [](const uint8_t *ram) { return static_cast<int8_t>(ram[0x300]) > 0 ? 1 : 0; },
+        [](const uint8_t *ram) { return ram[0x300] == 3 && ram[0x301] == 1; });
+  };
+
+  InputSearch::Result single = search(1);
+  CHECK(single.duplicates > 0);
+  for (int round = 0; round < 20; round++) {
+    InputSearch::Result parallel = search(4);
+    CHECK(parallel.inputs == single.inputs);
+    CHECK(parallel.goal == single.goal);
+    CHECK(parallel.duplicates == single.duplicates);
+    CHECK(parallel.evaluations == single.evaluations);
+  }
+}
+
+TEST_CASE("Input search returns the best state when the goal is out of reach") {
+  auto start = joypadGame();
+  start.nes->runFrame();
+
+  InputSearch::Options options;
+  options.inputs = {0, Controller::B};
+  options.max_depth = 3;
+  options.threads = 2;
+  InputSearch search([] { return joypadGame().nes; }, options);
+  InputSearch::Result result =
+      search.run(*start.nes, [](const uint8_t *ram) { return static_cast<int8_t>(ram[0x300]); },
+                 [](const uint8_t *ram) { return ram[0x300] == 4; });
+  CHECK_FALSE(result.goal);
+  CHECK(result.score == 0);
+  CHECK(result.inputs.empty());
+
+  CHECK_THROWS_AS(search.run(*start.nes, [](const uint8_t *) -> double { throw std::runtime_error("objective"); }),
+                  std::runtime_error);
+}
@@ -0,0 +1,411 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "PagedState.h"
+#include "Rewind.h"
+#include "StateHash.h"
+#include "doctest.h"
+#include "helpers/TestFixture.h"
+
+namespace {
+
+// Scribbles over $0200 - $02FF and the nametables
+std::vector<std::string> busyProgram() {
+  return {
+      "INX",         // $800
+      "INC $0200,X",
+      "STX $2007",
+      "JMP $0800",
+  };
+}
+
+} // namespace
+
+TEST_CASE("Machine states restore a run exactly") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+  nes.runFrame();
+
+  std::vector<uint8_t> saved;
+  nes.saveState(saved);
+  CHECK(fixture.bus->readByte(0x0000) == saved[0]);
+
+  nes.runFrame();
+  nes.runFrame();
+  std::vector<uint8_t> expected;
+  nes.saveState(expected);
+  uint64_t cycles = fixture.cpu->getCycles();
+
+  nes.loadState(saved);
+  CHECK(fixture.cpu->getCycles() < cycles);
+  nes.runFrame();
+  nes.runFrame();
+  std::vector<uint8_t> replayed;
+  nes.saveState(replayed);
+  CHECK(fixture.cpu->getCycles() == cycles);
+  CHECK(replayed == expected);
+
+  saved.pop_back();
+  CHECK_THROWS_AS(nes.loadState(saved), std::runtime_error);
+}
+
+TEST_CASE("Rewind returns states newest first") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+
+  std::vector<std::vector<uint8_t>> history;
+  std::vector<uint8_t> state;
+
+  SUBCASE("Everything fits") {
+    RewindBuffer rewind(1 << 20);
+    for (int i = 0; i < 30; i++) {
+      nes.runFrame();
+      nes.saveState(state);
+      rewind.push(state);
+      history.push_back(state);
+    }
+    CHECK(rewind.size() == 30);
+    // Deltas are much smaller than the states
+    CHECK(rewind.used() < 29 * state.size() / 10);
+
+    for (int i = 29; i >= 0; i--) {
+      REQUIRE(rewind.pop(state));
+      CHECK(state == history[i]);
+    }
+    CHECK_FALSE(rewind.pop(state));
+  }
+
+  SUBCASE("The oldest states are dropped") {
+    RewindBuffer rewind(4096);
+    for (int i = 0; i < 200; i++) {
+      nes.runFrame();
+      nes.saveState(state);
+      rewind.push(state);
+      history.push_back(state);
+      CHECK(rewind.used() <= 4096);
+    }
+    std::size_t kept = rewind.size();
+    CHECK(kept > 1);
+    CHECK(kept < 200);
+
+    // Interleave pops and pushes across the ring wrap-around
+    for (int i = 0; i < 3; i++) {
+      REQUIRE(rewind.pop(state));
+      CHECK(state == history.back());
+      history.pop_back();
+    }
+    nes.loadState(history.back());
+    for (int i = 0; i < 20; i++) {
+      nes.runFrame();
+      nes.saveState(state);
+      rewind.push(state);
+      history.push_back(state);
+    }
+    std::size_t count = rewind.size();
+    for (std::size_t i = 0; i < count; i++) {
+      REQUIRE(rewind.pop(state));
+      CHECK(state == history[history.size() - 1 - i]);
+    }
+    CHECK(rewind.size() == 0);
+  }
+}
+
+TEST_CASE("Rewinding then playing on keeps the history exact") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+  RewindBuffer rewind(1 << 20);
+  std::vector<std::vector<uint8_t>> history;
+  std::vector<uint8_t> state;
+  std::vector<StateRange> changed;
+
+  // Each frame also writes its own RAM block, away from busyProgram's
+  auto frame = [&](int i) {
+    fixture.bus->writeByte(0x0300 + i * 64, i + 1);
+    nes.runFrame();
+  };
+
+  nes.saveState(state);
+  for (int i = 0; i < 6; i++) {
+    frame(i);
+    changed.clear();
+    nes.updateState(state, &changed);
+    rewind.push(state, &changed);
+    history.push_back(state);
+  }
+
+  // Rewind one frame, load it into the synced buffer and play on
+  REQUIRE(rewind.pop(state));
+  CHECK(state == history.back());
+  history.pop_back();
+  nes.loadState(state);
+  for (int i = 6; i < 9; i++) {
+    frame(i);
+    changed.clear();
+    nes.updateState(state, &changed);
+    CHECK(changed.front().size < state.size()); // Incremental, not a full save
+    rewind.push(state, &changed);
+    history.push_back(state);
+  }
+
+  std::vector<uint8_t> popped;
+  for (std::size_t i = history.size(); i-- > 0;) {
+    REQUIRE(rewind.pop(popped));
+    CHECK(popped == history[i]);
+  }
+  CHECK_FALSE(rewind.pop(popped));
+}
+
+TEST_CASE("Dirty blocks keep incremental states exact") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+
+  SUBCASE("Writes mark their block") {
+    auto &ram = fixture.bus->dirtyRAM();
+    ram.clear();
+    fixture.bus->writeByte(0x0845, 1); // Mirror of $0045
+    fixture.bus->writeByte(0x07FF, 1);
+    CHECK(ram.count() == 2);
+    CHECK(ram.test(0x45 / 64));
+    CHECK(ram.test(0x7FF / 64));
+
+    auto &vram = fixture.bus->getPPU().dirtyNametables();
+    vram.clear();
+    fixture.bus->writeByte(0x2006, 0x24);
+    fixture.bus->writeByte(0x2006, 0x10);
+    fixture.bus->writeByte(0x2007, 0xAA);
+    std::vector<std::size_t> blocks;
+    vram.harvest([&](std::size_t block) { blocks.push_back(block); });
+    CHECK(blocks == std::vector<std::size_t>{0x10 / 64}); // Horizontal mirroring
+    CHECK_FALSE(vram.any());
+  }
+
+  SUBCASE("Updated states match full saves") {
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> full;
+    std::vector<StateRange> changed;
+    RewindBuffer rewind(1 << 20);
+    std::vector<std::vector<uint8_t>> history;
+
+    nes.saveState(state);
+    for (int i = 0; i < 10; i++) {
+      nes.runFrame();
+      changed.clear();
+      nes.updateState(state, &changed);
+      rewind.push(state, &changed);
+      history.push_back(state);
+
+      std::size_t total = 0;
+      for (const auto &range : changed) {
+        total += range.size;
+      }
+      CHECK(total < state.size() / 4);
+
+      std::vector<uint8_t> copy = state;
+      nes.saveState(full);
+      CHECK(full == copy);
+      // saveState synced another buffer, the next update is a full save
+      changed.clear();
+      nes.updateState(state, &changed);
+      CHECK(changed.size() == 1);
+      CHECK(state == full);
+    }
+
+    for (int i = 9; i > 0; i--) {
+      REQUIRE(rewind.pop(state));
+      CHECK(state == history[i]);
+    }
+  }
+}
+
+TEST_CASE("Resetting to the synced state only restores written blocks") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+  nes.runFrame();
+
+  std::vector<uint8_t> snapshot;
+  nes.saveState(snapshot);
+  std::vector<uint8_t> state;
+  for (int i = 0; i < 3; i++) {
+    nes.runFrame();
+    nes.runFrame();
+    nes.resetState(snapshot);
+    CHECK(fixture.bus->dirtyRAM().count() == 0);
+    // Another buffer, loadState happens instead
+    nes.saveState(state);
+    CHECK(state == snapshot);
+    nes.resetState(snapshot);
+  }
+}
+
+TEST_CASE("Forked states share unchanged pages") {
+  auto fixture = TestFixture::setupTest({
+      "INC $0210",   // $800, one RAM byte per loop
+      "JMP $0800",
+  });
+  auto &nes = *fixture.nes;
+  nes.runFrame();
+
+  PagedState root;
+  root.capture(nes);
+  std::vector<uint8_t> rootState;
+  root.read(rootState);
+
+  std::vector<PagedState> branches;
+  std::vector<std::vector<uint8_t>> expected;
+  for (int i = 0; i < 16; i++) {
+    PagedState branch = root.fork();
+    branch.restore(nes);
+    fixture.bus->writeByte(0x0300, i); // Diverge
+    nes.runFrame();
+    branch.capture(nes);
+    expected.emplace_back();
+    nes.saveState(expected.back());
+    branches.push_back(std::move(branch));
+  }
+
+  // Each branch only owns the pages its frame changed
+  for (const auto &branch : branches) {
+    CHECK(branch.ownedPages() > 0);
+    CHECK(branch.ownedPages() * 8 < branch.pageCount());
+  }
+
+  // Copy on write left the root untouched
+  std::vector<uint8_t> state;
+  root.read(state);
+  CHECK(state == rootState);
+
+  for (std::size_t i = 0; i < branches.size(); i++) {
+    branches[i].read(state);
+    CHECK(state == expected[i]);
+    branches[i].restore(nes);
+    CHECK(fixture.bus->readByte(0x0300) == i);
+  }
+}
+
+TEST_CASE("Fingerprints follow the machine contents, not its history") {
+  auto fixture = TestFixture::setupTest(busyProgram());
+  auto &nes = *fixture.nes;
+  auto &bus = *fixture.bus;
+  nes.runFrame();
+  uint64_t reference = nes.fingerprint();
+  CHECK(nes.fingerprint() == reference);
+
+  // A write and its undo cancel out, mirrors included
+  uint8_t old = bus.readByte(0x0123);
+  bus.writeByte(0x0123, old ^ 0x5A);
+  CHECK(nes.fingerprint() != reference);
+  bus.writeByte(0x0923, old);
+  CHECK(nes.fingerprint() == reference);
+
+  std::vector<uint8_t> state;
+  nes.saveState(state);
+
+  // Same VRAM and registers reached through different writes
+  auto writeVRAM = [&](uint8_t value) {
+    bus.writeByte(0x2006, 0x21);
+    bus.writeByte(0x2006, 0x00);
+    bus.writeByte(0x2007, value);
+  };
+  writeVRAM(0x11);
+  uint64_t first = nes.fingerprint();
+  writeVRAM(0x22);
+  uint64_t twice = nes.fingerprint();
+  CHECK(twice != first);
+  nes.loadState(state);
+  CHECK(nes.fingerprint() == reference);
+  writeVRAM(0x22);
+  CHECK(nes.fingerprint() == twice);
+
+  // Another machine loading the state, then running the same frames
+  auto other = TestFixture::setupTest(busyProgram());
+  nes.loadState(state);
+  other.nes->loadState(state);
+  CHECK(other.nes->fingerprint() == reference);
+  for (int i = 0; i < 3; i++) {
+    nes.runFrame();
+    other.nes->runFrame();
+    CHECK(other.nes->fingerprint() == nes.fingerprint());
+    CHECK(nes.fingerprint() != reference);
+  }
+}
+
+TEST_CASE("Per-frame state hashes locate the first divergence") {
+  CHECK(hash64("", 0) == 0xEF46DB3751D8E999ULL);
+  CHECK(hash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+  auto record = [](int frames, int perturbAt) {
+    auto fixture = TestFixture::setupTest(busyProgram());
+    std::stringstream stream;
+    HashStreamWriter writer(stream);
+    fixture.nes->setHashStream(&writer);
+    for (int i = 0; i < frames; i++) {
+      if (i == perturbAt) {
+        fixture.bus->writeByte(0x0700, 0xFF);
+      }
+      fixture.nes->runFrame();
+    }
+    return stream.str();
+  };
+
+  std::string reference = record(10, -1);
+  auto compare = [&](const std::string &other) {
+    std::stringstream a(reference);
+    std::stringstream b(other);
+    return compareHashStreams(a, b);
+  };
+
+  CHECK_FALSE(compare(record(10, -1)).has_value());
+
+  auto diverged = compare(record(10, 6));
+  REQUIRE(diverged.has_value());
+  CHECK(diverged->kind == HashMismatch::Kind::Hash);
+  CHECK(diverged->frame == 7);
+  CHECK(diverged->last_match == 6);
+
+  std::string short_run = record(8, -1);
+  auto shorter = compare(short_run);
+  REQUIRE(shorter.has_value());
+  CHECK(shorter->kind == HashMismatch::Kind::Length);
+  CHECK(shorter->frame == 9);
+  CHECK(shorter->first_longer);
+  CHECK(shorter->last_match == 8);
+
+  std::stringstream short_first(short_run);
+  std::stringstream long_second(reference);
+  auto longer = compareHashStreams(short_first, long_second);
+  REQUIRE(longer.has_value());
+  CHECK_FALSE(longer->first_longer);
+
+  // A zero hash does not decide which stream is longer
+  auto stream = [](std::initializer_list<FrameHash> records) {
+    std::stringstream out;
+    HashStreamWriter writer(out);
+    for (const FrameHash &record : records) {
+      writer.write(record);
+    }
+    return out.str();
+  };
+  std::stringstream zero_tail(stream({{1, 5}, {2, 0}}));
+  std::stringstream one_frame(stream({{1, 5}}));
+  auto zero = compareHashStreams(zero_tail, one_frame);
+  REQUIRE(zero.has_value());
+  CHECK(zero->kind == HashMismatch::Kind::Length);
+  CHECK(zero->first_longer);
+
+  std::stringstream skipping(stream({{1, 5}, {2, 6}, {4, 7}}));
+  std::stringstream every(stream({{1, 5}, {2, 6}, {3, 7}}));
+  auto skipped = compareHashStreams(skipping, every);
+  REQUIRE(skipped.has_value());
+  CHECK(skipped->kind == HashMismatch::Kind::Frame);
+  CHECK(skipped->frame == 3);
+  CHECK(skipped->last_match == 2);
+
+  std::stringstream garbage("not a hash stream");
+  std::stringstream valid(reference);
+  CHECK_THROWS_AS(compareHashStreams(garbage, valid), std::runtime_error);
+}
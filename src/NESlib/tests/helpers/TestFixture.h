@@ -7,11 +7,14 @@
 #include "Assembler.h"
 #include "Bus.h"
 #include "CPU.h"
+#include "NES.h"
 #include "mappers/DummyMapper.h"
 
 namespace TestFixture {
 
 struct NES_Test {
+  std::shared_ptr<NES> nes;
+  // Aliases of the components owned by nes
   std::shared_ptr<CPU_6502> cpu;
   std::shared_ptr<Bus> bus;
 };
@@ -24,8 +27,8 @@ struct NES_Test {
 inline NES_Test setupTest(std::vector<std::string> program,
                           uint16_t startAddress = 0x800) {
 
-  auto mapper = std::make_shared<DummyMapper>();
-  auto bus = std::make_shared<Bus>(mapper.get());
+  auto nes = std::make_shared<NES>(std::make_unique<DummyMapper>());
+  auto bus = std::shared_ptr<Bus>(nes, &nes->getBus());
 
   // Set reset vector
   bus->writeByte(0xFFFC, startAddress & 0xFF); // High byte
@@ -39,10 +42,10 @@ inline NES_Test setupTest(std::vector<std::string> program,
   }
 
   // Setup the CPU
-  auto cpu = std::make_shared<CPU_6502>(bus.get());
+  auto cpu = std::shared_ptr<CPU_6502>(nes, &nes->getCPU());
   cpu->reset();
 
-  return NES_Test{std::move(cpu), std::move(bus)};
+  return NES_Test{std::move(nes), std::move(cpu), std::move(bus)};
 }
 
 inline NES_Test setupTestAndExecute(std::vector<std::string> program,
@@ -52,4 +55,42 @@ inline NES_Test setupTestAndExecute(std::vector<std::string> program,
   return std::move(fixture);
 }
 
+/**
+ * Minimal game for the search and fuzz tests: NMIs are on, each one
+ * strobes controller 1 and adds the A button to $0300, then runs handler,
+ * which may read the next buttons from $4016.
+ *
+ */
+inline NES_Test setupJoypadTest(const std::vector<std::string> &handler = {},
+                                std::unique_ptr<Mapper> mapper = std::make_unique<DummyMapper>()) {
+  std::vector<std::string> main = {
+      "LDA #$80", // $800, NMI on
+      "STA $2000",
+      "JMP $0805",
+  };
+  std::vector<std::string> program = main;
+  program.insert(program.end(), {
+      "LDA #$01",  "STA $4016", "LDA #$00", "STA $4016",
+      "LDA $4016", "AND #$01",  "CLC",      "ADC $0300", "STA $0300",
+  });
+  program.insert(program.end(), handler.begin(), handler.end());
+  program.push_back("RTI");
+
+  auto nes = std::make_shared<NES>(std::move(mapper));
+  auto bus = std::shared_ptr<Bus>(nes, &nes->getBus());
+  int PC = 0x800;
+  for (auto programByte : Assembler().assemble(program)) {
+    bus->writeByte(PC++, programByte);
+  }
+  uint16_t nmi = 0x800 + Assembler().assemble(main).size();
+  bus->writeByte(0xFFFA, nmi & 0xFF);
+  bus->writeByte(0xFFFB, nmi >> 8);
+  bus->writeByte(0xFFFC, 0x00);
+  bus->writeByte(0xFFFD, 0x08);
+
+  auto cpu = std::shared_ptr<CPU_6502>(nes, &nes->getCPU());
+  cpu->reset();
+  return NES_Test{std::move(nes), std::move(cpu), std::move(bus)};
+}
+
 } // namespace TestFixture
\ No newline at end of file
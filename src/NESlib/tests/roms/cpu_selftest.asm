@@ -0,0 +1,204 @@
+; Small self-checking CPU test, the default program of the functional-test
+; target, see tests/FunctionalTest.cpp. Runs every check PASSES times, then
+; traps at success; a failed check traps at the *_failed label of its
+; group. It sticks to what CPU_6502 implements today: absolute indexed
+; addressing, carry into ADC and SBC, CPX, CPY, BIT, STY and the flags of
+; LDY and PLA are left to Klaus Dormann's test, see
+; NES_FUNCTIONAL_TEST_SOURCE.
+
+origin = $8000
+PASSES = 200
+
+pointer = $10           ; Zero page pointer to table
+counter = $12           ; Passes left, 16 bits
+scratch = $20
+table = $0200
+
+        .org origin
+
+start:  ldx #$FF
+        txs
+        lda #<PASSES
+        sta counter
+        lda #>PASSES
+        sta counter+1
+
+; Loads set N and Z
+pass:   lda #$00
+        bne loads_failed
+        lda #$80
+        bpl loads_failed
+        ldx #$00
+        bne loads_failed
+        ldx #$FF
+        bpl loads_failed
+        jmp adc
+loads_failed:
+        jmp loads_failed
+
+; Carry and overflow out of ADC
+adc:    clc
+        lda #$7F
+        adc #$01
+        bvc adc_failed
+        bcs adc_failed
+        cmp #$80
+        bne adc_failed
+        clc
+        lda #$FF
+        adc #$01
+        bcc adc_failed
+        bvs adc_failed
+        cmp #$00
+        bne adc_failed
+        jmp logic
+adc_failed:
+        jmp adc_failed
+
+; AND, ORA, EOR
+logic:  lda #$F0
+        and #$3C
+        cmp #$30
+        bne logic_failed
+        ora #$0F
+        cmp #$3F
+        bne logic_failed
+        eor #$FF
+        bpl logic_failed
+        cmp #$C0
+        bne logic_failed
+        jmp shifts
+logic_failed:
+        jmp logic_failed
+
+; Shifts, through the carry
+shifts: lda #$81
+        asl
+        bcc shifts_failed
+        cmp #$02
+        bne shifts_failed
+        lsr
+        bcs shifts_failed
+        lsr
+        bcc shifts_failed
+        bne shifts_failed
+        lda #$40
+        sec
+        rol
+        bcs shifts_failed
+        cmp #$81
+        bne shifts_failed
+        lda #$C0
+        sta scratch
+        asl scratch
+        bcc shifts_failed
+        lda scratch
+        cmp #$80
+        bne shifts_failed
+        jmp compare
+shifts_failed:
+        jmp shifts_failed
+
+; Compares set Z and C
+compare:
+        lda #$40
+        cmp #$40
+        bne compare_failed
+        bcc compare_failed
+        cmp #$41
+        beq compare_failed
+        bcs compare_failed
+        cmp #$3F
+        bcc compare_failed
+        jmp memory
+compare_failed:
+        jmp compare_failed
+
+; Indexed and indirect addressing: fill table with its indices, sum it
+memory: lda #<table
+        sta pointer
+        lda #>table
+        sta pointer+1
+        ldy #$00
+fill:   tya
+        sta (pointer),y
+        iny
+        bne fill
+        lda #$00
+        sta scratch
+        sta scratch+1
+        ldy #$00
+sum:    clc
+        lda (pointer),y
+        adc scratch
+        sta scratch
+        bcc no_carry
+        inc scratch+1
+no_carry:
+        iny
+        bne sum
+        lda scratch             ; 0 + 1 + ... + 255 = $7F80
+        cmp #$80
+        bne memory_failed
+        lda scratch+1
+        cmp #$7F
+        bne memory_failed
+        ldx #$05
+        lda #$5A
+        sta scratch,x
+        lda scratch+5
+        cmp #$5A
+        bne memory_failed
+        dec scratch+5
+        lda scratch+5
+        cmp #$59
+        bne memory_failed
+        ldy #$03
+        lda (pointer),y
+        cmp #$03
+        bne memory_failed
+        jmp stack
+memory_failed:
+        jmp memory_failed
+
+; Stack and subroutines
+stack:  lda #$A5
+        pha
+        lda #$00
+        php
+        lda #$01
+        plp
+        bne stack_failed
+        pla
+        cmp #$A5
+        bne stack_failed
+        lda #$00
+        jsr increment
+        jsr increment
+        cmp #$02
+        bne stack_failed
+        tsx
+        txa
+        cmp #$FF
+        bne stack_failed
+        jmp next
+stack_failed:
+        jmp stack_failed
+
+increment:
+        clc
+        adc #$01
+        rts
+
+next:   lda counter
+        bne next_low
+        dec counter+1
+next_low:
+        dec counter
+        lda counter
+        ora counter+1
+        beq success
+        jmp pass
+
+success:
+        jmp success
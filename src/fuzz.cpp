@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Cartridge.h"
+#include "FileLoader.h"
+#include "FuzzHarness.h"
+#include "NES.h"
+#ifdef NES_COVERAGE
+#include "Coverage.h"
+#endif
+
+// Fuzz driver over controller streams, see FuzzHarness.
+//
+// Standalone: nesfuzz <rom.nes> [case...] runs each case file, or one case
+// read from stdin (in a loop under afl-clang-fast persistent mode). Exits
+// with 1 when a case jams the CPU or throws.
+//
+// With NES_LIBFUZZER, the libFuzzer entry points replace main and read the
+// ROM path from NES_FUZZ_ROM. Findings abort so libFuzzer keeps the case.
+//
+// NES_FUZZ_MAX_STEPS and NES_FUZZ_SCANLINES override the case length and
+// the input unit, see FuzzHarness::Options. Whole frames cap throughput
+// at ~25k execs/s per core, shorter inputs run faster; the standalone
+// driver prints the rate it got.
+
+extern "C" void __sanitizer_set_death_callback(void (*callback)()) __attribute__((weak));
+
+namespace {
+
+std::unique_ptr<FuzzHarness> harness;
+const char *current_case = "";
+
+void report(const char *name, const FuzzHarness::Result &result) {
+    switch (result.outcome) {
+    case FuzzHarness::Outcome::Ok:
+        break;
+    case FuzzHarness::Outcome::Jam:
+        std::fprintf(stderr, "%s: CPU jammed at $%04X after %zu steps\n", name, result.pc, result.steps);
+        break;
+    case FuzzHarness::Outcome::Exception:
+        std::fprintf(stderr, "%s: exception after %zu steps: %s\n", name, result.steps,
+                     result.message.c_str());
+        break;
+    }
+}
+
+// Whole standard input into data, reusing its storage
+void readStdin(std::vector<uint8_t> &data) {
+    data.clear();
+    std::size_t size = 0;
+    while (true) {
+        data.resize(std::max<std::size_t>(size + 4096, data.capacity()));
+        ssize_t count = ::read(0, data.data() + size, data.size() - size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        size += static_cast<std::size_t>(count);
+    }
+    data.resize(size);
+}
+
+FuzzHarness::Options optionsFromEnvironment() {
+    FuzzHarness::Options options;
+    if (const char *steps = std::getenv("NES_FUZZ_MAX_STEPS")) {
+        options.max_steps = std::stoul(steps);
+    }
+    if (const char *scanlines = std::getenv("NES_FUZZ_SCANLINES")) {
+        options.step_scanlines = std::stoul(scanlines);
+    }
+    return options;
+}
+
+// Names the case when a sanitizer kills the process
+void onSanitizerDeath() { std::fprintf(stderr, "while running %s\n", current_case); }
+
+bool setup(const std::string &rom) {
+    try {
+        std::shared_ptr<NES> nes = NES::fromFile(rom);
+        nes->reset();
+#ifdef NES_COVERAGE
+#ifdef NES_LIBFUZZER
+        // libFuzzer picks up counters in this section as extra feedback
+        __attribute__((section("__libfuzzer_extra_counters"))) static uint8_t counters[CoverageMap::DEFAULT_SIZE];
+        static CoverageMap coverage(counters, sizeof(counters));
+        nes->getCPU().attachCoverage(&coverage);
+#else
+        static std::unique_ptr<CoverageMap> coverage = CoverageMap::fromAFLEnvironment();
+        nes->getCPU().attachCoverage(coverage.get());
+#endif
+#endif
+        harness = std::make_unique<FuzzHarness>(nes, optionsFromEnvironment());
+    } catch (const std::exception &e) {
+        std::cerr << rom << ": " << e.what() << std::endl;
+        return false;
+    }
+    if (__sanitizer_set_death_callback) {
+        __sanitizer_set_death_callback(onSanitizerDeath);
+    }
+    return true;
+}
+
+} // namespace
+
+#ifdef NES_LIBFUZZER
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    const char *rom = std::getenv("NES_FUZZ_ROM");
+    if (!rom || !setup(rom)) {
+        std::cerr << "Set NES_FUZZ_ROM to the ROM to fuzz" << std::endl;
+        std::exit(2);
+    }
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    FuzzHarness::Result result = harness->run(data, size);
+    if (result.outcome != FuzzHarness::Outcome::Ok) {
+        report("input", result);
+        std::abort();
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <rom.nes> [case...]" << std::endl;
+        return 2;
+    }
+    if (!setup(argv[1])) {
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool found = false;
+    if (argc == 2) {
+        current_case = "<stdin>";
+        // read(2) rather than std::cin: the stream stays at EOF after the
+        // first case, afl-fuzz feeds each case on the same stdin
+        std::vector<uint8_t> data;
+#ifdef __AFL_LOOP
+        while (__AFL_LOOP(10000)) {
+#endif
+            readStdin(data);
+            FuzzHarness::Result result = harness->run(data.data(), data.size());
+            report(current_case, result);
+            found |= result.outcome != FuzzHarness::Outcome::Ok;
+#ifdef __AFL_LOOP
+        }
+#endif
+    }
+
+    // Cases are read in the background while the earlier ones run
+    FileLoader loader;
+    std::vector<std::size_t> tickets;
+    for (int i = 2; i < argc; i++) {
+        tickets.push_back(loader.submit(argv[i]));
+    }
+    loader.flush();
+
+    for (int i = 2; i < argc; i++) {
+        current_case = argv[i];
+        std::vector<uint8_t> data;
+        try {
+            data = loader.wait(tickets[i - 2]);
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+        FuzzHarness::Result result = harness->run(data.data(), data.size());
+        report(argv[i], result);
+        found |= result.outcome != FuzzHarness::Outcome::Ok;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::fprintf(stderr, "%llu execs, %.0f execs/s\n", static_cast<unsigned long long>(harness->executions()),
+                 harness->executions() / std::max(elapsed.count(), 1e-9));
+    return found ? 1 : 0;
+}
+
+#endif
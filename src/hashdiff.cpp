@@ -0,0 +1,56 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "StateHash.h"
+
+// Compare two state hash streams recorded with `emu --hashes`, reports the
+// first frame where the runs diverge
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <first.hashes> <second.hashes>" << std::endl;
+        return 2;
+    }
+
+    std::ifstream first(argv[1], std::ios::binary);
+    std::ifstream second(argv[2], std::ios::binary);
+    if (!first || !second) {
+        std::cerr << "Cannot open " << (first ? argv[2] : argv[1]) << std::endl;
+        return 2;
+    }
+
+    try {
+        auto mismatch = compareHashStreams(first, second);
+        if (!mismatch) {
+            std::cout << "Identical" << std::endl;
+            return 0;
+        }
+
+        std::cout << std::hex << std::setfill('0');
+        switch (mismatch->kind) {
+        case HashMismatch::Kind::Hash:
+            std::cout << "Diverged at frame " << std::dec << mismatch->frame << std::hex << ": "
+                      << std::setw(16) << mismatch->first << " != " << std::setw(16) << mismatch->second;
+            break;
+        case HashMismatch::Kind::Frame:
+            std::cout << "Recorded frames differ ";
+            if (mismatch->last_match) {
+                std::cout << "after frame " << std::dec << *mismatch->last_match;
+            } else {
+                std::cout << "from the first record";
+            }
+            std::cout << ": " << std::dec << mismatch->first << " != " << mismatch->second;
+            break;
+        case HashMismatch::Kind::Length:
+            std::cout << (mismatch->first_longer ? argv[2] : argv[1]) << " ends before frame " << std::dec
+                      << mismatch->frame;
+            break;
+        }
+        std::cout << std::endl;
+        return 1;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -1,22 +1,90 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
-#include "CPU.h"
-#include "Bus.h"
 #include "Cartridge.h"
-#include "mappers/MapperNROM.h"
+#include "NES.h"
 
 int main(int argc, char* argv[]) {
-    std::string filename = std::string(argv[1]);
-    Cartridge cart{filename};
-    MapperNROM mapper(&cart);
+    // Options first, then positional arguments
+    std::string hashes;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--hashes" && i + 1 < argc) {
+            hashes = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
 
-    auto bus = std::make_unique<Bus>(&mapper);
-    auto cpu = std::make_unique<CPU_6502>(bus.get());
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--hashes <out.hashes>] <rom.nes> [frames] [symbols.lst]"
+                  << std::endl;
+        return 1;
+    }
 
-    cpu.reset();
+    std::string filename = args[0];
+    int frames = args.size() > 1 ? std::stoi(args[1]) : 1;
 
-//    bus->printState(0x8000,0xFFF0);
+    std::unique_ptr<NES> nes;
+    try {
+        nes = NES::fromFile(filename);
+    } catch (const CartridgeError &e) {
+        std::cerr << filename << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Battery backed RAM lives in game.sav next to game.nes
+    std::string save = std::filesystem::path(filename).replace_extension(".sav").string();
+    try {
+        nes->attachSaveFile(save);
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+#ifdef NES_PROFILER
+    Profiler profiler;
+    CallGraph callgraph;
+    SymbolTable symbols;
+    if (args.size() > 2 && !symbols.loadFile(args[2])) {
+        std::cerr << "Cannot read symbols from " << args[2] << std::endl;
+    }
+    nes->getCPU().attachProfiler(&profiler);
+    nes->getCPU().attachCallGraph(&callgraph);
+#endif
+
+    // Per-frame state hashes, compare runs with hashdiff
+    std::ofstream hashFile;
+    std::unique_ptr<HashStreamWriter> hashStream;
+    if (!hashes.empty()) {
+        hashFile.open(hashes, std::ios::binary);
+        hashStream = std::make_unique<HashStreamWriter>(hashFile);
+        nes->setHashStream(hashStream.get());
+    }
+
+    nes->reset();
+    for (int i = 0; i < frames; i++) {
+        nes->runFrame();
+    }
+
+#ifdef NES_PROFILER
+    profiler.report(std::cerr);
+    std::ofstream dump(filename + ".profile.csv");
+    profiler.dump(dump);
+
+    std::cerr << std::endl;
+    callgraph.report(std::cerr, symbols);
+    std::ofstream folded(filename + ".folded");
+    callgraph.exportCollapsed(folded, symbols);
+#endif
+
+//    nes->getBus().printState(0x8000,0xFFF0);
 
     return 0;
 }
@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Cartridge.h"
+#include "RomIndex.h"
+#include "mappers/MapperFactory.h"
+
+// ROM library index, see RomIndex.
+//
+//   rom-index build <directory> <index> [threads]
+//   rom-index lookup <index> <rom.nes>...
+//
+// lookup identifies each ROM by content and lists the indexed files holding
+// the same ROM, with the header they were indexed with.
+namespace {
+
+const char *mirroringName(Mirroring mirroring) {
+    switch (mirroring) {
+    case Mirroring::Horizontal:
+        return "horizontal";
+    case Mirroring::Vertical:
+        return "vertical";
+    case Mirroring::FourScreen:
+        return "four-screen";
+    }
+    return "?";
+}
+
+void print(const RomIndex::Entry &entry) {
+    const CartridgeHeader &h = entry.header;
+    std::printf("  %016llx %08x mapper %u.%u (%s), PRG %zukB, CHR %zukB, %s%s  %s\n",
+                static_cast<unsigned long long>(entry.hash), entry.crc, h.mapper, h.submapper,
+                MapperFactory::name(h.mapper).c_str(), h.prg_rom_size / 1024, h.chr_rom_size / 1024,
+                mirroringName(h.mirroring), h.battery ? ", battery" : "", entry.path.c_str());
+}
+
+int build(const std::string &root, const std::string &output, unsigned threads) {
+    RomIndex::ScanStats stats;
+    RomIndex index = RomIndex::scan(root, threads, &stats);
+    std::ofstream file(output, std::ios_base::binary);
+    index.save(file);
+    if (!file) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 2;
+    }
+    std::printf("%zu ROMs indexed, %zu files skipped\n", index.size(), stats.skipped);
+    return 0;
+}
+
+int lookup(const std::string &path, const std::vector<std::string> &roms) {
+    std::ifstream file(path, std::ios_base::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 2;
+    }
+    RomIndex index = RomIndex::load(file);
+
+    int missing = 0;
+    for (const auto &rom : roms) {
+        Cartridge cartridge(rom);
+        auto key = RomIndex::identify(cartridge);
+        auto matches = index.find(key.hash);
+        std::printf("%s: %s\n", rom.c_str(), matches.empty() ? "not indexed" : "");
+        for (const auto &entry : matches) {
+            print(entry);
+        }
+        missing += matches.empty();
+    }
+    return missing ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    try {
+        if (command == "build" && (argc == 4 || argc == 5)) {
+            unsigned threads = argc == 5 ? std::stoul(argv[4]) : std::thread::hardware_concurrency();
+            return build(argv[2], argv[3], threads);
+        }
+        if (command == "lookup" && argc >= 4) {
+            return lookup(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    std::cerr << "Usage: " << argv[0] << " build <directory> <index> [threads]" << std::endl
+              << "       " << argv[0] << " lookup <index> <rom.nes>..." << std::endl;
+    return 2;
+}